@@ -0,0 +1,124 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+// 审核积压的老师改分申请的吞吐量：
+//	three-step  原来的做法，SELECT、UPDATE、DELETE 三条语句各自自动提交
+//	per-txn     approve_teacher_request（DELETE ... RETURNING + UPDATE），每条申请一个事务
+//	batched     approve_teacher_request，像写线程那样多条申请放进一个事务，每条一个SAVEPOINT
+// 用法: approval_bench [申请数] [每批条数]
+
+#include "approvals.h"
+#include "bench_common.h"
+#include "connection.h"
+#include "migrations.h"
+
+using namespace std;
+
+static void queue_requests(Connection& conn, int count) {
+	bench::exec_or_die(conn.get(), "BEGIN;");
+	auto stmt = conn.prepare("INSERT INTO requests_teacher (req_id, stu_id, option, new_score, course_id) VALUES (?, ?, 'score1', ?, ?);");
+	for (int i = 0; i < count; i++) {
+		int stu_id = i + 1;
+		string req_id = "req" + to_string(i);
+		string course_id = "C" + to_string(stu_id % 50);
+		sqlite3_bind_text(stmt, 1, req_id.c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_int(stmt, 2, stu_id);
+		sqlite3_bind_int(stmt, 3, 60 + i % 40);
+		sqlite3_bind_text(stmt, 4, course_id.c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_step(stmt);
+		sqlite3_reset(stmt);
+	}
+	bench::exec_or_die(conn.get(), "COMMIT;");
+}
+
+static void three_step(Connection& conn, const string& req_id) {
+	int stu_id, score;
+	string course_id;
+	{
+		auto stmt = conn.prepare("SELECT stu_id, new_score, course_id FROM requests_teacher WHERE req_id = ?;");
+		sqlite3_bind_text(stmt, 1, req_id.c_str(), -1, SQLITE_STATIC);
+		if (sqlite3_step(stmt) != SQLITE_ROW)
+			return;
+		stu_id = sqlite3_column_int(stmt, 0);
+		score = sqlite3_column_int(stmt, 1);
+		course_id = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+	}
+
+	auto update_stmt = conn.prepare("UPDATE enrollments SET score = ? WHERE student_id = ? AND course_id = ?;");
+	sqlite3_bind_int(update_stmt, 1, score);
+	sqlite3_bind_int(update_stmt, 2, stu_id);
+	sqlite3_bind_text(update_stmt, 3, course_id.c_str(), -1, SQLITE_STATIC);
+	sqlite3_step(update_stmt);
+
+	auto delete_stmt = conn.prepare("DELETE FROM requests_teacher WHERE req_id = ?;");
+	sqlite3_bind_text(delete_stmt, 1, req_id.c_str(), -1, SQLITE_STATIC);
+	sqlite3_step(delete_stmt);
+}
+
+static bool approve(Connection& conn, const string& req_id) {
+	bench::exec_or_die(conn.get(), "SAVEPOINT job;");
+	bool ok = approve_teacher_request(conn, req_id).status == ApprovalStatus::Ok;
+	bench::exec_or_die(conn.get(), ok ? "RELEASE job;" : "ROLLBACK TO job; RELEASE job;");
+	return ok;
+}
+
+static int remaining(Connection& conn) {
+	auto stmt = conn.prepare("SELECT COUNT(*) FROM requests_teacher;");
+	sqlite3_step(stmt);
+	return sqlite3_column_int(stmt, 0);
+}
+
+template <typename F>
+static void run(const char* name, Connection& conn, int count, F approve_all) {
+	queue_requests(conn, count);
+	bench::Stopwatch sw;
+	approve_all();
+	double s = sw.seconds();
+	cout << name << "\t" << count / s << "\t\t" << remaining(conn) << endl;
+}
+
+int main(int argc, char** argv) {
+	int count = bench::arg_int(argc, argv, 1, 10000);
+	int batch = bench::arg_int(argc, argv, 2, 256);
+	string path = "approval_bench.db";
+
+	bench::create_legacy_db(path, count, 50);
+	Connection conn(path);
+	run_migrations(conn);
+	// 和服务器一样使用WAL模式
+	bench::exec_or_die(conn.get(), "PRAGMA journal_mode=WAL;");
+
+	cout << count << " queued teacher requests, batch size " << batch << endl;
+	cout << "path\t\tapprovals/s\tleft" << endl;
+
+	run("three-step", conn, count, [&] {
+		for (int i = 0; i < count; i++)
+			three_step(conn, "req" + to_string(i));
+	});
+
+	run("per-txn\t", conn, count, [&] {
+		for (int i = 0; i < count; i++) {
+			Transaction txn(conn);
+			approve(conn, "req" + to_string(i));
+			txn.commit();
+		}
+	});
+
+	run("batched\t", conn, count, [&] {
+		for (int i = 0; i < count; i += batch) {
+			Transaction txn(conn);
+			for (int j = i; j < min(count, i + batch); j++)
+				approve(conn, "req" + to_string(j));
+			txn.commit();
+		}
+	});
+
+	remove(path.c_str());
+	remove((path + "-wal").c_str());
+	remove((path + "-shm").c_str());
+	return 0;
+}
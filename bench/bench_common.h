@@ -0,0 +1,92 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+// 性能测试共用的小工具：建临时数据库、计时
+
+#pragma once
+
+#include <sqlite3.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace bench {
+
+inline void exec_or_die(sqlite3* db, const std::string& sql) {
+	char* err = nullptr;
+	if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &err) != SQLITE_OK) {
+		std::cerr << "SQL error: " << (err ? err : "") << "\n  in: " << sql << std::endl;
+		sqlite3_free(err);
+		std::exit(1);
+	}
+}
+
+// 和 build/init.sql 相同的原始表结构（没有主键和索引）
+inline const char* legacy_schema() {
+	return R"(
+		CREATE TABLE teachers (id INTEGER, name TEXT, course_name TEXT, password INTEGER, course1 TEXT, course2 TEXT);
+		CREATE TABLE students (id INTEGER, name TEXT, class INTEGER, password INTEGER, course1 TEXT, course2 TEXT,
+			score1 INTEGER, score2 INTEGER, phone_number TEXT, gender INTEGER, wish TEXT,
+			able_to_revise1 INTEGER, able_to_revise2 INTEGER);
+		CREATE TABLE requests_teacher (req_id TEXT, stu_id INTEGER, option TEXT, new_score INTEGER);
+		CREATE TABLE requests_student (req_id TEXT, id INTEGER, name TEXT, gender INTEGER, phone_number TEXT, wish TEXT);
+	)";
+}
+
+// 在 path 新建一个原始结构的数据库，学生id为 1..students，平均分到 courses 门课里
+inline void create_legacy_db(const std::string& path, int students, int courses) {
+	std::remove(path.c_str());
+	std::remove((path + "-wal").c_str());
+	std::remove((path + "-shm").c_str());
+
+	sqlite3* db;
+	sqlite3_open(path.c_str(), &db);
+	exec_or_die(db, legacy_schema());
+	exec_or_die(db, "BEGIN;");
+
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db,
+		"INSERT INTO students VALUES (?, ?, ?, 123456, ?, ?, -1, -1, '-1', -1, '保内', 1, 1);",
+		-1, &stmt, nullptr);
+	for (int id = 1; id <= students; id++) {
+		std::string name = "student" + std::to_string(id);
+		std::string c1 = "C" + std::to_string(id % courses);
+		std::string c2 = "C" + std::to_string((id + 1) % courses);
+		sqlite3_bind_int(stmt, 1, id);
+		sqlite3_bind_text(stmt, 2, name.c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_int(stmt, 3, id % 40);
+		sqlite3_bind_text(stmt, 4, c1.c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_text(stmt, 5, c2.c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_step(stmt);
+		sqlite3_reset(stmt);
+	}
+	sqlite3_finalize(stmt);
+
+	exec_or_die(db, "COMMIT;");
+	sqlite3_close(db);
+}
+
+// 整数型命令行参数，没给就用默认值
+inline int arg_int(int argc, char** argv, int idx, int def) {
+	return argc > idx ? std::atoi(argv[idx]) : def;
+}
+
+class Stopwatch {
+public:
+	Stopwatch() : start_(std::chrono::steady_clock::now()) {}
+	double seconds() const {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+	}
+	double micros() const { return seconds() * 1e6; }
+
+private:
+	std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace bench
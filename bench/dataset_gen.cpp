@@ -0,0 +1,321 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+// 生成指定规模的测试数据库，方便在1万、10万、100万学生的数据上重复比较性能改动。
+// 表结构由 run_migrations 建好，和服务器用的完全一样；数据用同一个随机种子生成，同样的参数每次结果都一样。
+//
+// 用法: dataset_gen <输出.db> [--students 10000] [--courses 50] [--per-student 2] [--skew 1.0] [--graded 0.9]
+//                   [--teacher-requests 1000] [--student-requests 1000] [--seed 42]
+//	--per-student      每个学生选几门课
+//	--skew             课程热门程度的Zipf指数，0为均匀，越大选课越集中在前几门课
+//	--graded           已经录入成绩的选课比例，其余为 -1
+//	--*-requests       待审核的改分申请 / 个人信息修改申请的条数
+// 学生id为 1..students，密码都是123；老师每人教两门课，id从1开始，密码都是111；课程为 C0..C(courses-1)。
+// 输出文件已经存在时拒绝覆盖。
+//
+// 写入时关闭日志和同步（文件是新建的，出错了重新生成就行），整个生成过程是一个事务，
+// 先删掉 enrollments 按课程的索引，插完再建；逐行维护成绩汇总表的插入触发器占了插入选课一半的时间，
+// 也先删掉（保存建触发器的SQL），插完用 rebuild_course_aggregates 一次算好，再把触发器建回去。
+
+#include "bench_common.h"
+#include "connection.h"
+#include "course_aggregates.h"
+#include "csv_import.h"
+#include "migrations.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct Options {
+	string path;
+	int students = 10000;
+	int courses = 50;
+	int per_student = 2;
+	double skew = 1.0;
+	double graded = 0.9;
+	int teacher_requests = 1000;
+	int student_requests = 1000;
+	uint64_t seed = 42;
+};
+
+[[noreturn]] void usage(const string& error) {
+	cerr << error << "\nusage: dataset_gen <output.db> [--students N] [--courses N] [--per-student K] [--skew S]"
+		" [--graded F] [--teacher-requests N] [--student-requests N] [--seed S]" << endl;
+	exit(1);
+}
+
+Options parse_options(int argc, char** argv) {
+	if (argc < 2 || argv[1][0] == '-')
+		usage("Missing output path");
+	Options o;
+	o.path = argv[1];
+	for (int i = 2; i < argc; i += 2) {
+		string key = argv[i];
+		if (i + 1 >= argc)
+			usage("Missing value for " + key);
+		const char* value = argv[i + 1];
+		if (key == "--students") o.students = atoi(value);
+		else if (key == "--courses") o.courses = atoi(value);
+		else if (key == "--per-student") o.per_student = atoi(value);
+		else if (key == "--skew") o.skew = atof(value);
+		else if (key == "--graded") o.graded = atof(value);
+		else if (key == "--teacher-requests") o.teacher_requests = atoi(value);
+		else if (key == "--student-requests") o.student_requests = atoi(value);
+		else if (key == "--seed") o.seed = strtoull(value, nullptr, 10);
+		else
+			usage("Unknown option " + key);
+	}
+	if (o.students <= 0 || o.courses <= 0 || o.per_student < 0 || o.skew < 0 || o.graded < 0 || o.graded > 1
+		|| o.teacher_requests < 0 || o.student_requests < 0)
+		usage("Invalid options");
+	o.per_student = min(o.per_student, o.courses);
+	return o;
+}
+
+const char* const kSurnames[] = {"王", "李", "张", "刘", "陈", "杨", "黄", "赵", "吴", "周", "徐", "孙", "马", "朱", "胡", "郭"};
+const char* const kGiven[] = {"伟", "芳", "娜", "敏", "静", "丽", "强", "磊", "军", "洋", "勇", "艳", "杰", "娟", "涛", "明"};
+
+string random_name(mt19937_64& rng) {
+	string name = kSurnames[rng() % size(kSurnames)];
+	name += kGiven[rng() % size(kGiven)];
+	if (rng() % 2)
+		name += kGiven[rng() % size(kGiven)];
+	return name;
+}
+
+string random_phone(mt19937_64& rng) {
+	return "13" + to_string(100000000 + rng() % 900000000);
+}
+
+class Generator {
+public:
+	explicit Generator(const Options& o) : o_(o), weights_(o.courses), taken_(o.courses, false) {
+		// 第k门课的热门程度正比于 1/(k+1)^skew
+		for (int k = 0; k < o.courses; k++) {
+			weights_[k] = 1.0 / pow(k + 1, o.skew);
+			total_ += weights_[k];
+		}
+		popularity_ = discrete_distribution<int>(weights_.begin(), weights_.end());
+	}
+
+	/*
+	 学生选的课只由种子和学号决定，生成申请时可以重新算出来，不用把所有选课留在内存里。
+	 不放回地按热门程度抽 per_student 门课：已选的课还只占总权重的一小部分时，
+	 直接从整个分布里抽、抽到选过的就重抽（和不放回抽样的分布相同，平均不到两次）；
+	 之后剩下的课权重太小，重抽可能要很多次（--per-student 接近 --courses、--skew 很大时几乎停不下来），
+	 改为在没选过的课里按权重扫一遍。
+	*/
+	void courses_of(int student, vector<int>& out) {
+		mt19937_64 rng(o_.seed * 1000003 + student);
+		out.clear();
+		double picked = 0; // 已选的课的权重之和
+		while (static_cast<int>(out.size()) < o_.per_student) {
+			int course;
+			if (picked < total_ / 2) {
+				course = popularity_(rng);
+				if (taken_[course])
+					continue;
+			} else
+				course = pick_remaining(rng, picked);
+			taken_[course] = true;
+			out.push_back(course);
+			picked += weights_[course];
+		}
+		for (int course : out)
+			taken_[course] = false;
+	}
+
+private:
+	// 在没选过的课里按权重抽一门
+	int pick_remaining(mt19937_64& rng, double picked) {
+		double r = uniform_real_distribution<double>(0, total_ - picked)(rng);
+		int last = -1;
+		for (int k = 0; k < o_.courses; k++) {
+			if (taken_[k])
+				continue;
+			last = k;
+			r -= weights_[k];
+			if (r < 0)
+				break;
+		}
+		return last; // 浮点误差让 r 最后没有小于0时，取最后一门没选过的课
+	}
+
+	const Options& o_;
+	vector<double> weights_;
+	double total_ = 0;
+	discrete_distribution<int> popularity_;
+	vector<bool> taken_; // 正在生成的这个学生已经选了哪些课，courses_of 返回前清空
+};
+
+void step_or_throw(sqlite3* db, sqlite3_stmt* stmt) {
+	if (sqlite3_step(stmt) != SQLITE_DONE)
+		throw runtime_error(sqlite3_errmsg(db));
+	sqlite3_reset(stmt);
+}
+
+void report(const char* table, size_t rows, const bench::Stopwatch& sw) {
+	double seconds = sw.seconds();
+	printf("%-18s %10zu rows %8.2f s %12.0f rows/s\n", table, rows, seconds, seconds > 0 ? rows / seconds : 0);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	Options o = parse_options(argc, argv);
+	if (filesystem::exists(o.path)) {
+		cerr << o.path << " already exists" << endl;
+		return 1;
+	}
+
+	try {
+		Connection conn(o.path);
+		sqlite3* db = conn.get();
+		run_migrations(conn);
+
+		bench::exec_or_die(db, "PRAGMA journal_mode=OFF; PRAGMA synchronous=OFF; PRAGMA cache_size=-262144;");
+		bench::exec_or_die(db, "BEGIN;");
+		drop_import_indexes(conn, ImportKind::Enrollments);
+		string trigger_sql;
+		{
+			auto stmt = conn.prepare("SELECT sql FROM sqlite_schema WHERE type = 'trigger' AND name = 'enrollments_aggregate_insert';");
+			if (!stmt || sqlite3_step(stmt) != SQLITE_ROW)
+				throw runtime_error("enrollments_aggregate_insert trigger not found");
+			trigger_sql = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+		}
+		bench::exec_or_die(db, "DROP TRIGGER enrollments_aggregate_insert;");
+
+		mt19937_64 rng(o.seed);
+		Generator gen(o);
+		bench::Stopwatch total;
+
+		// 学生和选课按学号顺序插入，主键都是追加到B树末尾
+		{
+			bench::Stopwatch sw;
+			auto student_stmt = conn.prepare("INSERT INTO students (id, name, class, password, phone_number, gender, wish) VALUES (?, ?, ?, 123, ?, ?, ?);");
+			auto enroll_stmt = conn.prepare("INSERT INTO enrollments (student_id, course_id, score, able_to_revise) VALUES (?, ?, ?, 1);");
+			if (!student_stmt || !enroll_stmt)
+				throw runtime_error(sqlite3_errmsg(db));
+
+			vector<string> course_ids(o.courses);
+			for (int k = 0; k < o.courses; k++)
+				course_ids[k] = "C" + to_string(k);
+
+			normal_distribution<double> score(75, 12);
+			bernoulli_distribution graded(o.graded);
+			vector<int> courses;
+			size_t enrollments = 0;
+			for (int id = 1; id <= o.students; id++) {
+				string name = random_name(rng);
+				string phone = random_phone(rng);
+				sqlite3_bind_int(student_stmt, 1, id);
+				sqlite3_bind_text(student_stmt, 2, name.c_str(), -1, SQLITE_STATIC);
+				sqlite3_bind_int(student_stmt, 3, id % 40 + 1);
+				sqlite3_bind_text(student_stmt, 4, phone.c_str(), -1, SQLITE_STATIC);
+				sqlite3_bind_int(student_stmt, 5, static_cast<int>(rng() % 2));
+				sqlite3_bind_text(student_stmt, 6, rng() % 4 ? "保内" : "保外", -1, SQLITE_STATIC);
+				step_or_throw(db, student_stmt);
+
+				gen.courses_of(id, courses);
+				for (int course : courses) {
+					sqlite3_bind_int(enroll_stmt, 1, id);
+					sqlite3_bind_text(enroll_stmt, 2, course_ids[course].c_str(), -1, SQLITE_STATIC);
+					sqlite3_bind_int(enroll_stmt, 3, graded(rng) ? clamp(static_cast<int>(score(rng)), 0, 100) : -1);
+					step_or_throw(db, enroll_stmt);
+					enrollments++;
+				}
+			}
+			report("students", o.students, sw);
+			printf("%-18s %10zu rows\n", "enrollments", enrollments);
+		}
+
+		{
+			bench::Stopwatch sw;
+			auto stmt = conn.prepare("INSERT INTO teachers (id, name, course_name, password, course1, course2) VALUES (?, ?, ?, 111, ?, ?);");
+			int teachers = (o.courses + 1) / 2;
+			for (int id = 1; id <= teachers; id++) {
+				string name = random_name(rng);
+				string course1 = "C" + to_string(2 * (id - 1));
+				string course2 = 2 * id - 1 < o.courses ? "C" + to_string(2 * id - 1) : "";
+				sqlite3_bind_int(stmt, 1, id);
+				sqlite3_bind_text(stmt, 2, name.c_str(), -1, SQLITE_STATIC);
+				sqlite3_bind_text(stmt, 3, course1.c_str(), -1, SQLITE_STATIC);
+				sqlite3_bind_text(stmt, 4, course1.c_str(), -1, SQLITE_STATIC);
+				sqlite3_bind_text(stmt, 5, course2.c_str(), -1, SQLITE_STATIC);
+				step_or_throw(db, stmt);
+			}
+			report("teachers", teachers, sw);
+		}
+
+		// 改分申请针对学生真正选了的课
+		if (o.per_student > 0) {
+			bench::Stopwatch sw;
+			auto stmt = conn.prepare("INSERT INTO requests_teacher (req_id, stu_id, option, new_score, course_id) VALUES (?, ?, ?, ?, ?);");
+			uniform_int_distribution<int> student(1, o.students);
+			vector<int> courses;
+			for (int i = 0; i < o.teacher_requests; i++) {
+				int stu_id = student(rng);
+				gen.courses_of(stu_id, courses);
+				size_t which = rng() % courses.size();
+				string req_id = "t" + to_string(i + 1);
+				string option = "score" + to_string(which + 1);
+				string course_id = "C" + to_string(courses[which]);
+				sqlite3_bind_text(stmt, 1, req_id.c_str(), -1, SQLITE_STATIC);
+				sqlite3_bind_int(stmt, 2, stu_id);
+				sqlite3_bind_text(stmt, 3, option.c_str(), -1, SQLITE_STATIC);
+				sqlite3_bind_int(stmt, 4, static_cast<int>(rng() % 101));
+				sqlite3_bind_text(stmt, 5, course_id.c_str(), -1, SQLITE_STATIC);
+				step_or_throw(db, stmt);
+			}
+			report("requests_teacher", o.teacher_requests, sw);
+		}
+
+		{
+			bench::Stopwatch sw;
+			auto stmt = conn.prepare("INSERT INTO requests_student (req_id, id, name, gender, phone_number, wish) VALUES (?, ?, ?, ?, ?, ?);");
+			uniform_int_distribution<int> student(1, o.students);
+			for (int i = 0; i < o.student_requests; i++) {
+				string req_id = "s" + to_string(i + 1);
+				string name = random_name(rng);
+				string phone = random_phone(rng);
+				sqlite3_bind_text(stmt, 1, req_id.c_str(), -1, SQLITE_STATIC);
+				sqlite3_bind_int(stmt, 2, student(rng));
+				sqlite3_bind_text(stmt, 3, name.c_str(), -1, SQLITE_STATIC);
+				sqlite3_bind_int(stmt, 4, static_cast<int>(rng() % 2));
+				sqlite3_bind_text(stmt, 5, phone.c_str(), -1, SQLITE_STATIC);
+				sqlite3_bind_text(stmt, 6, rng() % 4 ? "保内" : "保外", -1, SQLITE_STATIC);
+				step_or_throw(db, stmt);
+			}
+			report("requests_student", o.student_requests, sw);
+		}
+
+		{
+			bench::Stopwatch sw;
+			// 先重建汇总表再建索引：没有索引时 GROUP BY 顺序扫描整张表再排序，比按索引逐行回表快
+			rebuild_course_aggregates(conn);
+			create_import_indexes(conn, ImportKind::Enrollments);
+			bench::exec_or_die(db, trigger_sql + ";");
+			bench::exec_or_die(db, "COMMIT; ANALYZE;");
+			report("index + aggregates", 0, sw);
+		}
+		// 恢复默认的日志模式，服务器启动时会切换到WAL
+		bench::exec_or_die(db, "PRAGMA journal_mode=DELETE;");
+		printf("%s generated in %.2f s\n", o.path.c_str(), total.seconds());
+	} catch (const exception& e) {
+		cerr << "Failed: " << e.what() << endl;
+		return 1;
+	}
+	return 0;
+}
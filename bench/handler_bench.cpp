@@ -0,0 +1,194 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+// 不经过网络，直接在进程里调用 register_routes 注册的handler，测每个接口本身（解析、SQL、生成JSON）的耗时。
+// 对着临时数据库建一套和服务器一样的写线程、读线程池和缓存，构造 crow::request 交给 app.handle_full。
+// 异步handler的结果由读写线程 post 到 req.io_service，这里给请求一个自己的 io_service，run_one 等它完成。
+// 有缓存的接口分别测命中（cached）和每次先清掉缓存（cold）两种情况。
+// 用法: handler_bench [学生数] [每个接口调用次数]
+
+#include "backup.h"
+#include "batch_progress.h"
+#include "bench_common.h"
+#include "connection.h"
+#include "course_stats.h"
+#include "db_executor.h"
+#include "db_writer.h"
+#include "export.h"
+#include "metrics.h"
+#include "migrations.h"
+#include "record_cache.h"
+#include "roster_cache.h"
+#include "routes.h"
+#include "sql_profiler.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// asio 的 io_service，Crow 用独立的 asio 还是 boost::asio 都能用
+using IoService = remove_pointer_t<decltype(crow::request::io_service)>;
+
+class Driver {
+public:
+	explicit Driver(ServerApp& app) : app_(app), work_(io_) {}
+
+	// 发一个请求，等响应结束后返回
+	crow::response call(crow::HTTPMethod method, const string& url, string body) {
+		crow::request req;
+		req.method = method;
+		req.url = url;
+		req.raw_url = url;
+		req.body = move(body);
+		req.headers.emplace("Cookie", "session_id=1, session_type=admin");
+		req.io_service = &io_;
+
+		crow::response res;
+		app_.handle_full(req, res);
+		while (!res.is_completed())
+			io_.run_one();
+		return res;
+	}
+
+private:
+	ServerApp& app_;
+	IoService io_;
+	IoService::work work_;
+};
+
+struct Case {
+	const char* name;
+	crow::HTTPMethod method;
+	const char* url;
+	// 生成第i次调用的请求体，也可以在这里清缓存
+	function<string(int)> body;
+};
+
+void run(Driver& driver, const Case& c, int rounds) {
+	for (int i = 0; i < 10; i++)
+		driver.call(c.method, c.url, c.body(i));
+
+	vector<double> latency;
+	latency.reserve(rounds);
+	int errors = 0;
+	size_t bytes = 0;
+	bench::Stopwatch total;
+	for (int i = 0; i < rounds; i++) {
+		string body = c.body(i);
+		bench::Stopwatch sw;
+		crow::response res = driver.call(c.method, c.url, move(body));
+		latency.push_back(sw.micros());
+		if (res.code >= 400)
+			errors++;
+		bytes += res.body.size();
+	}
+	double seconds = total.seconds();
+
+	sort(latency.begin(), latency.end());
+	double sum = 0;
+	for (double us : latency)
+		sum += us;
+	printf("%-22s %10.0f %9.1f %9.1f %9.1f %9zu %7d\n", c.name, rounds / seconds, sum / rounds,
+		latency[latency.size() / 2], latency[latency.size() * 99 / 100], bytes / rounds, errors);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	int students = bench::arg_int(argc, argv, 1, 10000);
+	int rounds = bench::arg_int(argc, argv, 2, 2000);
+	const int courses = 50;
+	string path = "handler_bench.db";
+
+	// 旧结构的数据库升级到最新版本，每个学生选两门课，密码都是123456
+	bench::create_legacy_db(path, students, courses);
+	RecordCache cache;
+	{
+		Connection conn(path);
+		run_migrations(conn);
+		cache.load_all(conn);
+	}
+
+	RosterCache rosters;
+	ScoreColumns scores;
+	BatchProgress batches;
+	{
+		Metrics metrics;
+		SqlProfiler profiler(path, chrono::milliseconds(0));
+		DbWriter writer(path);
+		DbExecutor readers(path, 2);
+		ExportDirectory exports("handler_bench_exports");
+		DbBackup backup(path, "handler_bench_backups");
+		Services services{writer, readers, cache, rosters, scores, batches, exports, backup, metrics, profiler};
+
+		ServerApp app;
+		register_routes(app, services);
+		app.validate();
+		Driver driver(app);
+
+		auto student = [students](int i) { return to_string(i % students + 1); };
+		auto course = [](int i) { return "C" + to_string(i % courses); };
+		vector<Case> cases = {
+			{"login (cached)", crow::HTTPMethod::Post, "/login", [&](int i) {
+				return "{\"user_type\":\"student\",\"name\":" + student(i) + ",\"password\":123456}";
+			}},
+			{"login (cold)", crow::HTTPMethod::Post, "/login", [&](int i) {
+				cache.invalidate_student(i % students + 1);
+				return "{\"user_type\":\"student\",\"name\":" + student(i) + ",\"password\":123456}";
+			}},
+			{"get_course (cached)", crow::HTTPMethod::Post, "/get_course", [&](int i) {
+				return "{\"course_id\":\"" + course(i) + "\"}";
+			}},
+			{"get_course (cold)", crow::HTTPMethod::Post, "/get_course", [&](int i) {
+				rosters.invalidate(course(i));
+				return "{\"course_id\":\"" + course(i) + "\"}";
+			}},
+			{"course_stats (cached)", crow::HTTPMethod::Post, "/course_stats", [&](int i) {
+				return "{\"course_id\":\"" + course(i) + "\"}";
+			}},
+			{"course_stats (cold)", crow::HTTPMethod::Post, "/course_stats", [&](int i) {
+				scores.invalidate(course(i));
+				return "{\"course_id\":\"" + course(i) + "\"}";
+			}},
+			{"course_summary", crow::HTTPMethod::Post, "/course_summary", [&](int i) {
+				return "{\"course_id\":\"" + course(i) + "\"}";
+			}},
+			{"insert_score", crow::HTTPMethod::Post, "/insert_score", [&](int i) {
+				return "[{\"stu_id\":" + student(i) + ",\"option\":\"score1\",\"new_score\":" + to_string(i % 101) + "}]";
+			}},
+			{"revise_score", crow::HTTPMethod::Post, "/revise_score", [&](int i) {
+				return "{\"req_time\":\"bench" + to_string(i) + "-" + to_string(rand()) + "\",\"stu_id\":" + student(i) +
+					",\"option\":\"score1\",\"new_score\":60}";
+			}},
+			{"info_modify", crow::HTTPMethod::Post, "/info_modify", [&](int i) {
+				return "{\"req_id\":\"bench" + to_string(i) + "-" + to_string(rand()) + "\",\"id\":" + student(i) +
+					",\"name\":\"bench\",\"gender\":0,\"phone_number\":\"100\",\"wish\":\"保内\"}";
+			}},
+			{"admin/requests", crow::HTTPMethod::Post, "/admin/requests", [&](int) {
+				return string("{\"req_type\":\"teacher\"}");
+			}},
+		};
+
+		cout << students << " students, " << courses << " courses, " << rounds << " calls per handler" << endl;
+		printf("%-22s %10s %9s %9s %9s %9s %7s\n", "handler", "calls/s", "mean us", "p50 us", "p99 us", "bytes", "errors");
+		for (const auto& c : cases)
+			run(driver, c, rounds);
+	}
+
+	remove(path.c_str());
+	remove((path + "-wal").c_str());
+	remove((path + "-shm").c_str());
+	filesystem::remove_all("handler_bench_exports");
+	filesystem::remove_all("handler_bench_backups");
+	return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+// 对比课程名单序列化的两种写法：原来逐行拷贝成 std::string 再组装 crow::json::wvalue 最后 dump，
+// 和 repository.h 的 RosterRow 加 write_json_row 直接从SQLite的内存写进可重复使用的缓冲区。同时统计每行的堆内存分配次数。
+// 用法: json_bench [名单人数] [次数]
+
+#include "bench_common.h"
+#include "connection.h"
+#include "crow/json.h"
+#include "json_writer.h"
+#include "migrations.h"
+#include "repository.h"
+
+#include <atomic>
+#include <new>
+#include <vector>
+
+using namespace std;
+
+// 统计 operator new 的调用次数
+static atomic<long> allocations{0};
+
+void* operator new(size_t size) {
+	allocations.fetch_add(1, memory_order_relaxed);
+	if (void* p = malloc(size ? size : 1))
+		return p;
+	throw bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static const string roster_sql = "SELECT " + columns_sql<RosterRow>() +
+	" FROM enrollments e JOIN students s ON s.id = e.student_id WHERE e.course_id = ? ORDER BY e.student_id;";
+
+// 原来 /get_course 的写法
+static size_t roster_wvalue(Connection& conn, string& out) {
+	auto stmt = conn.prepare(roster_sql);
+	sqlite3_bind_text(stmt, 1, "C0", -1, SQLITE_STATIC);
+
+	vector<crow::json::wvalue> student_list;
+	while (sqlite3_step(stmt) == SQLITE_ROW) {
+		int stu_id = sqlite3_column_int(stmt, 0);
+		string stu_name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+		int class_no = sqlite3_column_int(stmt, 2);
+		int score = sqlite3_column_int(stmt, 3);
+		bool able = sqlite3_column_int(stmt, 4);
+
+		crow::json::wvalue temp;
+		temp["id"] = stu_id;
+		temp["name"] = stu_name;
+		temp["class"] = class_no;
+		temp["score"] = score;
+		temp["able"] = able;
+		student_list.push_back(move(temp));
+	}
+	size_t rows = student_list.size();
+	out = crow::json::wvalue(student_list).dump();
+	return rows;
+}
+
+// RosterRow + json_writer.h 的写法
+static size_t roster_direct(Connection& conn, string& out) {
+	auto stmt = conn.prepare(roster_sql);
+	sqlite3_bind_text(stmt, 1, "C0", -1, SQLITE_STATIC);
+
+	out.clear();
+	JsonWriter w(out);
+	w.begin_array();
+	size_t rows = 0;
+	for_each_row<RosterRow>(stmt, [&w, &rows](const RosterRow& row) {
+		write_json_row(w, row);
+		rows++;
+	});
+	w.end_array();
+	return rows;
+}
+
+template <typename F>
+static void run(const char* name, Connection& conn, int rounds, F serialize) {
+	string out;
+	serialize(conn, out); // 预热：语句缓存、页缓存、输出缓冲区
+
+	long before = allocations.load();
+	size_t rows = 0;
+	bench::Stopwatch sw;
+	for (int i = 0; i < rounds; i++)
+		rows = serialize(conn, out);
+	double us = sw.micros() / rounds;
+	double allocs_per_row = double(allocations.load() - before) / rounds / max<size_t>(rows, 1);
+
+	cout << name << "\t" << rows << "\t" << us << "\t\t" << allocs_per_row << "\t\t" << out.size() << endl;
+}
+
+int main(int argc, char** argv) {
+	int students = bench::arg_int(argc, argv, 1, 10000);
+	int rounds = bench::arg_int(argc, argv, 2, 50);
+	string path = "json_bench.db";
+
+	// 只有两门课，每个学生两门都选，C0 的名单就是全部学生
+	bench::create_legacy_db(path, students, 2);
+	{
+		Connection conn(path);
+		run_migrations(conn);
+	}
+
+	Connection conn(path);
+	cout << "path\trows\tus/roster\tallocs/row\tbytes" << endl;
+	run("wvalue", conn, rounds, roster_wvalue);
+	run("direct", conn, rounds, roster_direct);
+
+	remove(path.c_str());
+	return 0;
+}
@@ -0,0 +1,501 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+// HTTP接口的压测工具：按给定比例混合发送 /login、/get_course、/insert_score、/revise_score、/info_modify，
+// 输出吞吐量和 p50/p90/p99/p99.9 延迟，可以另外输出JSON方便比较两次运行。
+//
+// 开环（open-loop）：请求按泊松过程在预定的时间点到达，不等上一个请求返回；
+// 延迟从预定的到达时间开始算，服务器变慢、连接都在忙导致请求排队的时间也算在里面，
+// 不会像"发一个等一个"那样服务器越慢发得越少，把排队掩盖掉。
+// 每个线程有自己的一组 keep-alive 长连接，用 ppoll 同时等待多个连接的响应。
+//
+// 用法: loadgen [--host 127.0.0.1] [--port 18080] [--rate 每秒请求数] [--duration 秒] [--threads 线程数]
+//               [--connections 总连接数] [--students 学生数] [--password 学生密码] [--courses 课程数]
+//               [--mix login=60,get_course=25,insert_score=5,revise_score=5,info_modify=5] [--json 文件|-]
+// 请求里的学生id在 1..students 里随机选（密码都是 --password），课程为 C0..C(courses-1)。
+// revise_score 和 info_modify 会往申请表里插入新的申请。
+
+#include "bench_common.h"
+#include "json_writer.h"
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+namespace {
+
+enum Op { Login, GetCourse, InsertScore, ReviseScore, InfoModify, kOps };
+const array<const char*, kOps> kOpNames = {"login", "get_course", "insert_score", "revise_score", "info_modify"};
+const array<const char*, kOps> kOpPaths = {"/login", "/get_course", "/insert_score", "/revise_score", "/info_modify"};
+
+struct Options {
+	string host = "127.0.0.1";
+	string port = "18080";
+	double rate = 1000;
+	double duration = 10;
+	int threads = 2;
+	int connections = 16;
+	int students = 1000;
+	int password = 123;
+	int courses = 50;
+	array<double, kOps> mix = {60, 25, 5, 5, 5};
+	string json;
+};
+
+// 一个线程的结果，每种请求的延迟（微秒）分开存
+struct Result {
+	array<vector<double>, kOps> latency;
+	array<uint64_t, kOps> errors{};
+	uint64_t timeouts = 0;
+	uint64_t reconnects = 0;
+};
+
+[[noreturn]] void usage(const string& error) {
+	cerr << error << "\nusage: loadgen [--host H] [--port P] [--rate R] [--duration S] [--threads T] [--connections C]"
+		" [--students N] [--password P] [--courses N] [--mix login=60,get_course=25,...] [--json FILE|-]" << endl;
+	exit(1);
+}
+
+Options parse_options(int argc, char** argv) {
+	Options o;
+	for (int i = 1; i < argc; i += 2) {
+		string key = argv[i];
+		if (i + 1 >= argc)
+			usage("Missing value for " + key);
+		string value = argv[i + 1];
+		if (key == "--host") o.host = value;
+		else if (key == "--port") o.port = value;
+		else if (key == "--rate") o.rate = atof(value.c_str());
+		else if (key == "--duration") o.duration = atof(value.c_str());
+		else if (key == "--threads") o.threads = atoi(value.c_str());
+		else if (key == "--connections") o.connections = atoi(value.c_str());
+		else if (key == "--students") o.students = atoi(value.c_str());
+		else if (key == "--password") o.password = atoi(value.c_str());
+		else if (key == "--courses") o.courses = atoi(value.c_str());
+		else if (key == "--json") o.json = value;
+		else if (key == "--mix") {
+			o.mix.fill(0);
+			size_t pos = 0;
+			while (pos < value.size()) {
+				size_t comma = value.find(',', pos);
+				string item = value.substr(pos, comma == string::npos ? string::npos : comma - pos);
+				size_t eq = item.find('=');
+				auto it = find(kOpNames.begin(), kOpNames.end(), item.substr(0, eq));
+				if (eq == string::npos || it == kOpNames.end())
+					usage("Bad --mix item: " + item);
+				o.mix[it - kOpNames.begin()] = atof(item.c_str() + eq + 1);
+				pos = comma == string::npos ? value.size() : comma + 1;
+			}
+		} else
+			usage("Unknown option " + key);
+	}
+	if (o.rate <= 0 || o.duration <= 0 || o.threads <= 0 || o.connections < o.threads || o.students <= 0 || o.courses <= 0)
+		usage("Invalid options");
+	return o;
+}
+
+int connect_to(const Options& o) {
+	addrinfo hints{}, *addrs;
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(o.host.c_str(), o.port.c_str(), &hints, &addrs) != 0)
+		return -1;
+
+	int fd = -1;
+	for (addrinfo* a = addrs; a; a = a->ai_next) {
+		fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+		if (fd < 0)
+			continue;
+		if (connect(fd, a->ai_addr, a->ai_addrlen) == 0)
+			break;
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(addrs);
+
+	if (fd >= 0) {
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	}
+	return fd;
+}
+
+// 每个线程各自生成请求，revise_score/info_modify 的申请编号用 运行编号-线程-序号 保证不重复
+class RequestBuilder {
+public:
+	RequestBuilder(const Options& o, int thread_id, uint64_t run_id)
+		: o_(o), prefix_("lg" + to_string(run_id) + "-" + to_string(thread_id) + "-"), rng_(run_id * 1000 + thread_id),
+		  pick_(o.mix.begin(), o.mix.end()) {}
+
+	Op pick() { return static_cast<Op>(pick_(rng_)); }
+
+	string build(Op op) {
+		int student = uniform_int_distribution<int>(1, o_.students)(rng_);
+		int score = uniform_int_distribution<int>(0, 100)(rng_);
+		string body;
+		switch (op) {
+		case Login:
+			body = "{\"user_type\":\"student\",\"name\":" + to_string(student) + ",\"password\":" + to_string(o_.password) + "}";
+			break;
+		case GetCourse:
+			body = "{\"course_id\":\"C" + to_string(uniform_int_distribution<int>(0, o_.courses - 1)(rng_)) + "\"}";
+			break;
+		case InsertScore:
+			body = "[{\"stu_id\":" + to_string(student) + ",\"option\":\"score1\",\"new_score\":" + to_string(score) + "}]";
+			break;
+		case ReviseScore:
+			body = "{\"req_time\":\"" + prefix_ + to_string(seq_++) + "\",\"stu_id\":" + to_string(student) +
+				",\"option\":\"score1\",\"new_score\":" + to_string(score) + "}";
+			break;
+		default:
+			body = "{\"req_id\":\"" + prefix_ + to_string(seq_++) + "\",\"id\":" + to_string(student) +
+				",\"name\":\"loadgen\",\"gender\":0,\"phone_number\":\"100\",\"wish\":\"保内\"}";
+		}
+
+		return string("POST ") + kOpPaths[op] + " HTTP/1.1\r\nHost: " + o_.host + "\r\nCookie: session_id=loadgen\r\n"
+			"Content-Type: application/json\r\nContent-Length: " + to_string(body.size()) + "\r\n\r\n" + body;
+	}
+
+	// 下一个请求到达前的间隔（秒），泊松过程
+	double interval(double rate) { return exponential_distribution<double>(rate)(rng_); }
+
+private:
+	const Options& o_;
+	string prefix_;
+	mt19937_64 rng_;
+	discrete_distribution<int> pick_;
+	uint64_t seq_ = 0;
+};
+
+struct Conn {
+	int fd = -1;
+	bool busy = false;
+	Op op = Login;
+	Clock::time_point intended;
+	string in;
+};
+
+bool send_all(int fd, const string& data) {
+	size_t sent = 0;
+	while (sent < data.size()) {
+		ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+		if (n <= 0) {
+			if (n < 0 && errno == EINTR)
+				continue;
+			return false;
+		}
+		sent += n;
+	}
+	return true;
+}
+
+// 缓冲区里有完整的响应时返回状态码并把它从缓冲区里去掉，不完整时返回0
+int take_response(string& in) {
+	size_t header_end = in.find("\r\n\r\n");
+	if (header_end == string::npos)
+		return 0;
+
+	size_t length = 0;
+	size_t line = in.find("\r\n");
+	while (line < header_end) {
+		size_t next = in.find("\r\n", line + 2);
+		const char name[] = "content-length:";
+		if (next - line - 2 > sizeof(name) - 1 && strncasecmp(in.c_str() + line + 2, name, sizeof(name) - 1) == 0)
+			length = strtoull(in.c_str() + line + 2 + sizeof(name) - 1, nullptr, 10);
+		line = next;
+	}
+	if (in.size() < header_end + 4 + length)
+		return 0;
+
+	int status = in.size() > 12 ? atoi(in.c_str() + 9) : 0;
+	in.erase(0, header_end + 4 + length);
+	return status ? status : -1;
+}
+
+void run_thread(const Options& o, int thread_id, int connections, uint64_t run_id, Clock::time_point start, Result& result) {
+	RequestBuilder builder(o, thread_id, run_id);
+	double rate = o.rate / o.threads;
+	auto end = start + chrono::duration_cast<Clock::duration>(chrono::duration<double>(o.duration));
+	// 停止发送后最多再等这么久，还没回来的算超时
+	auto drain_end = end + chrono::seconds(10);
+
+	vector<Conn> conns(connections);
+	for (auto& c : conns) {
+		c.fd = connect_to(o);
+		if (c.fd < 0) {
+			cerr << "Can't connect to " << o.host << ":" << o.port << endl;
+			exit(1);
+		}
+		c.in.reserve(64 * 1024);
+	}
+
+	deque<pair<Clock::time_point, Op>> backlog;
+	auto next_arrival = start + chrono::duration_cast<Clock::duration>(chrono::duration<double>(builder.interval(rate)));
+	vector<pollfd> fds;
+	vector<Conn*> polled;
+	char buf[65536];
+
+	while (true) {
+		auto now = Clock::now();
+		while (next_arrival <= now && next_arrival < end) {
+			backlog.emplace_back(next_arrival, builder.pick());
+			next_arrival += chrono::duration_cast<Clock::duration>(chrono::duration<double>(builder.interval(rate)));
+		}
+
+		for (auto& c : conns) {
+			if (c.busy || backlog.empty())
+				continue;
+			auto [intended, op] = backlog.front();
+			backlog.pop_front();
+			string request = builder.build(op);
+			if (!send_all(c.fd, request)) {
+				// 服务器关掉了这个长连接，重连一次
+				close(c.fd);
+				c.fd = connect_to(o);
+				result.reconnects++;
+				if (c.fd < 0 || !send_all(c.fd, request)) {
+					result.errors[op]++;
+					continue;
+				}
+			}
+			c.busy = true;
+			c.op = op;
+			c.intended = intended;
+		}
+
+		bool arrivals_done = next_arrival >= end;
+		size_t busy = count_if(conns.begin(), conns.end(), [](const Conn& c) { return c.busy; });
+		if (arrivals_done && backlog.empty() && busy == 0)
+			break;
+		if (now >= drain_end) {
+			result.timeouts += busy + backlog.size();
+			break;
+		}
+
+		fds.clear();
+		polled.clear();
+		for (auto& c : conns)
+			if (c.busy) {
+				fds.push_back({c.fd, POLLIN, 0});
+				polled.push_back(&c);
+			}
+
+		// 最多等到下一个请求到达，并且不超过1毫秒，这样到达时间不会因为等响应而推迟
+		auto wait = arrivals_done ? chrono::milliseconds(1) : min<Clock::duration>(next_arrival - now, chrono::milliseconds(1));
+		if (wait < Clock::duration::zero())
+			wait = Clock::duration::zero();
+		auto ns = chrono::duration_cast<chrono::nanoseconds>(wait).count();
+		timespec timeout{static_cast<time_t>(ns / 1000000000), static_cast<long>(ns % 1000000000)};
+		if (ppoll(fds.data(), fds.size(), &timeout, nullptr) <= 0)
+			continue;
+
+		for (size_t i = 0; i < fds.size(); i++) {
+			if (!fds[i].revents)
+				continue;
+			Conn& c = *polled[i];
+			ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+			if (n <= 0) {
+				result.errors[c.op]++;
+				result.reconnects++;
+				close(c.fd);
+				c.fd = connect_to(o);
+				c.busy = false;
+				c.in.clear();
+				if (c.fd < 0) {
+					cerr << "Lost connection to " << o.host << ":" << o.port << endl;
+					exit(1);
+				}
+				continue;
+			}
+			c.in.append(buf, n);
+
+			int status = take_response(c.in);
+			if (status == 0)
+				continue;
+			double us = chrono::duration<double, micro>(Clock::now() - c.intended).count();
+			result.latency[c.op].push_back(us);
+			if (status < 200 || status >= 300)
+				result.errors[c.op]++;
+			c.busy = false;
+		}
+	}
+
+	for (auto& c : conns)
+		if (c.fd >= 0)
+			close(c.fd);
+}
+
+// 已排序的延迟的 nearest-rank 百分位数，单位毫秒
+double percentile(const vector<double>& sorted, double q) {
+	if (sorted.empty())
+		return 0;
+	size_t rank = static_cast<size_t>(ceil(q * sorted.size()));
+	return sorted[max<size_t>(rank, 1) - 1] / 1000;
+}
+
+struct Summary {
+	uint64_t requests = 0;
+	uint64_t errors = 0;
+	double mean = 0, p50 = 0, p90 = 0, p99 = 0, p999 = 0, max = 0;
+};
+
+Summary summarize(vector<double>& latency, uint64_t errors) {
+	Summary s;
+	sort(latency.begin(), latency.end());
+	s.requests = latency.size();
+	s.errors = errors;
+	if (latency.empty())
+		return s;
+	double sum = 0;
+	for (double us : latency)
+		sum += us;
+	s.mean = sum / latency.size() / 1000;
+	s.p50 = percentile(latency, 0.5);
+	s.p90 = percentile(latency, 0.9);
+	s.p99 = percentile(latency, 0.99);
+	s.p999 = percentile(latency, 0.999);
+	s.max = latency.back() / 1000;
+	return s;
+}
+
+void write_summary(JsonWriter& w, const Summary& s, double seconds) {
+	w.begin_object();
+	w.key("requests"); w.value(static_cast<int64_t>(s.requests));
+	w.key("errors"); w.value(static_cast<int64_t>(s.errors));
+	w.key("throughput"); w.value(s.requests / seconds);
+	w.key("latency_ms");
+	w.begin_object();
+	w.key("mean"); w.value(s.mean);
+	w.key("p50"); w.value(s.p50);
+	w.key("p90"); w.value(s.p90);
+	w.key("p99"); w.value(s.p99);
+	w.key("p99.9"); w.value(s.p999);
+	w.key("max"); w.value(s.max);
+	w.end_object();
+	w.end_object();
+}
+
+void print_summary(const char* name, const Summary& s, double seconds) {
+	printf("%-14s %9llu %7llu %10.1f %9.3f %9.3f %9.3f %9.3f %9.3f\n", name, static_cast<unsigned long long>(s.requests),
+		static_cast<unsigned long long>(s.errors), s.requests / seconds, s.p50, s.p90, s.p99, s.p999, s.max);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	Options o = parse_options(argc, argv);
+	uint64_t run_id = chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
+
+	vector<Result> results(o.threads);
+	vector<thread> threads;
+	// 先建好所有连接再开始计时
+	auto start = Clock::now() + chrono::milliseconds(200);
+	for (int t = 0; t < o.threads; t++) {
+		int connections = o.connections / o.threads + (t < o.connections % o.threads ? 1 : 0);
+		threads.emplace_back(run_thread, cref(o), t, connections, run_id, start, ref(results[t]));
+	}
+	for (auto& t : threads)
+		t.join();
+	double seconds = chrono::duration<double>(Clock::now() - start).count();
+	// 吞吐量按发送请求的时长算，不包括最后等响应的时间
+	seconds = min(seconds, o.duration);
+
+	vector<double> all;
+	array<Summary, kOps> per_op;
+	uint64_t all_errors = 0, timeouts = 0, reconnects = 0;
+	for (int op = 0; op < kOps; op++) {
+		vector<double> latency;
+		uint64_t errors = 0;
+		for (auto& r : results) {
+			latency.insert(latency.end(), r.latency[op].begin(), r.latency[op].end());
+			errors += r.errors[op];
+		}
+		all.insert(all.end(), latency.begin(), latency.end());
+		all_errors += errors;
+		per_op[op] = summarize(latency, errors);
+	}
+	for (auto& r : results) {
+		timeouts += r.timeouts;
+		reconnects += r.reconnects;
+	}
+	Summary total = summarize(all, all_errors);
+
+	printf("target %.0f req/s for %.1fs, %d threads, %d connections\n", o.rate, o.duration, o.threads, o.connections);
+	printf("%-14s %9s %7s %10s %9s %9s %9s %9s %9s\n", "endpoint", "requests", "errors", "req/s", "p50 ms", "p90 ms", "p99 ms", "p99.9 ms", "max ms");
+	for (int op = 0; op < kOps; op++)
+		if (o.mix[op] > 0)
+			print_summary(kOpNames[op], per_op[op], seconds);
+	print_summary("total", total, seconds);
+	if (timeouts || reconnects)
+		printf("%llu timeouts, %llu reconnects\n", static_cast<unsigned long long>(timeouts), static_cast<unsigned long long>(reconnects));
+
+	if (!o.json.empty()) {
+		string out;
+		JsonWriter w(out);
+		w.begin_object();
+		w.key("config");
+		w.begin_object();
+		w.key("host"); w.value(o.host);
+		w.key("port"); w.value(o.port);
+		w.key("rate"); w.value(o.rate);
+		w.key("duration"); w.value(o.duration);
+		w.key("threads"); w.value(o.threads);
+		w.key("connections"); w.value(o.connections);
+		w.key("mix");
+		w.begin_object();
+		for (int op = 0; op < kOps; op++) {
+			w.key(kOpNames[op]);
+			w.value(o.mix[op]);
+		}
+		w.end_object();
+		w.end_object();
+		w.key("seconds"); w.value(seconds);
+		w.key("timeouts"); w.value(static_cast<int64_t>(timeouts));
+		w.key("reconnects"); w.value(static_cast<int64_t>(reconnects));
+		w.key("total");
+		write_summary(w, total, seconds);
+		w.key("endpoints");
+		w.begin_object();
+		for (int op = 0; op < kOps; op++)
+			if (o.mix[op] > 0) {
+				w.key(kOpNames[op]);
+				write_summary(w, per_op[op], seconds);
+			}
+		w.end_object();
+		w.end_object();
+
+		if (o.json == "-")
+			cout << out << endl;
+		else {
+			ofstream file(o.json);
+			file << out << endl;
+			if (!file) {
+				cerr << "Can't write " << o.json << endl;
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
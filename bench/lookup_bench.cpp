@@ -0,0 +1,98 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+// 对比升级前（没有主键和索引、选课存在students表里）和升级后（run_migrations）/login、/get_course、/unsolvereq 用到的查询延迟。
+// 用法: lookup_bench [学生数] [每种查询的次数]
+
+#include "bench_common.h"
+#include "connection.h"
+#include "migrations.h"
+
+#include <random>
+
+using namespace std;
+
+struct Result {
+	double login_us;
+	double course_us;
+	double req_us;
+};
+
+static Result measure(Connection& conn, int students, int rounds) {
+	mt19937 rng(42);
+	uniform_int_distribution<int> pick_id(1, students);
+	Result r;
+
+	bench::Stopwatch sw;
+	for (int i = 0; i < rounds; i++) {
+		auto stmt = conn.prepare("SELECT * FROM students WHERE id = ?;");
+		sqlite3_bind_int(stmt, 1, pick_id(rng));
+		while (sqlite3_step(stmt) == SQLITE_ROW) {
+		}
+	}
+	r.login_us = sw.micros() / rounds;
+
+	// 名单查询本身要读很多行，次数少一些。升级后选课在enrollments表里
+	const char* course_sql = schema_version(conn) >= 3
+		? "SELECT s.* FROM enrollments e JOIN students s ON s.id = e.student_id WHERE e.course_id = ?;"
+		: "SELECT * FROM students WHERE course1 = ? or course2 = ?;";
+	int course_rounds = max(1, rounds / 10);
+	sw = bench::Stopwatch();
+	for (int i = 0; i < course_rounds; i++) {
+		string course = "C" + to_string(i % 50);
+		auto stmt = conn.prepare(course_sql);
+		sqlite3_bind_text(stmt, 1, course.c_str(), -1, SQLITE_TRANSIENT);
+		if (sqlite3_bind_parameter_count(stmt) > 1)
+			sqlite3_bind_text(stmt, 2, course.c_str(), -1, SQLITE_TRANSIENT);
+		while (sqlite3_step(stmt) == SQLITE_ROW) {
+		}
+	}
+	r.course_us = sw.micros() / course_rounds;
+
+	sw = bench::Stopwatch();
+	for (int i = 0; i < rounds; i++) {
+		string req_id = "req" + to_string(pick_id(rng) % 10000);
+		auto stmt = conn.prepare("SELECT * FROM requests_teacher WHERE req_id = ?;");
+		sqlite3_bind_text(stmt, 1, req_id.c_str(), -1, SQLITE_TRANSIENT);
+		while (sqlite3_step(stmt) == SQLITE_ROW) {
+		}
+	}
+	r.req_us = sw.micros() / rounds;
+
+	return r;
+}
+
+int main(int argc, char** argv) {
+	int students = bench::arg_int(argc, argv, 1, 100000);
+	int rounds = bench::arg_int(argc, argv, 2, 2000);
+	string path = "lookup_bench.db";
+
+	bench::create_legacy_db(path, students, 50);
+
+	Connection conn(path);
+	bench::exec_or_die(conn.get(), "BEGIN;");
+	for (int i = 0; i < 10000; i++)
+		bench::exec_or_die(conn.get(), "INSERT INTO requests_teacher VALUES ('req" + to_string(i) + "', " + to_string(i + 1) + ", 'score1', 90);");
+	bench::exec_or_die(conn.get(), "COMMIT;");
+
+	Result before = measure(conn, students, rounds);
+
+	bench::Stopwatch sw;
+	run_migrations(conn);
+	double migrate_s = sw.seconds();
+
+	Result after = measure(conn, students, rounds);
+
+	cout << students << " students, 10000 pending teacher requests, migration took " << migrate_s << " s" << endl;
+	cout << "query\t\t\tbefore(us)\tafter(us)" << endl;
+	cout << "login (id = ?)\t\t" << before.login_us << "\t\t" << after.login_us << endl;
+	cout << "get_course (course)\t" << before.course_us << "\t\t" << after.course_us << endl;
+	cout << "unsolvereq (req_id = ?)\t" << before.req_us << "\t\t" << after.req_us << endl;
+
+	remove(path.c_str());
+	return 0;
+}
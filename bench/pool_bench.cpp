@@ -0,0 +1,140 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+// 读线程池（DbExecutor）的读吞吐量随线程数的变化：线程数从1到 hardware_concurrency，
+// 按8:2混合提交 /login 和 /get_course 缓存未命中时的读任务（和 routes.cpp 里读线程执行的一样），
+// 每个线程保持若干个请求在排队，统计每秒完成的读请求数。
+// 结果和 handler_bench 一样 post 到请求的 io_service，由主线程 run_one 收回后再提交下一个。
+// 用法: pool_bench [最大线程数] [学生数] [每轮秒数]
+
+#include "bench_common.h"
+#include "connection.h"
+#include "db_executor.h"
+#include "migrations.h"
+#include "record_cache.h"
+#include "repository.h"
+#include "roster_cache.h"
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+using IoService = remove_pointer_t<decltype(crow::request::io_service)>;
+
+const int kCourses = 50;
+// 每个读线程同时在排队的请求数，保证线程不会因为等主线程提交而空闲
+const int kInFlightPerThread = 4;
+
+struct Call {
+	crow::request req;
+	crow::response res;
+};
+
+// 第i个读请求：/login 读学生和他的选课，/get_course 读一门课的名单并序列化
+DbExecutor::Job read_job(int i, int students) {
+	if (i % 5 != 0) {
+		int id = i % students + 1;
+		return [id](Connection& conn) {
+			auto record = load_student(conn, id);
+			return crow::response(record ? 200 : 404);
+		};
+	}
+	string course = "C" + to_string(i % kCourses);
+	return [course](Connection& conn) {
+		static const string sql = "SELECT " + columns_sql<RosterRow>() +
+			" FROM enrollments e JOIN students s ON s.id = e.student_id WHERE e.course_id = ? ORDER BY e.student_id;";
+		auto stmt = conn.prepare(sql);
+		if (!stmt)
+			return crow::response(500);
+		sqlite3_bind_text(stmt, 1, course.c_str(), -1, SQLITE_TRANSIENT);
+
+		vector<RosterEntry> entries;
+		for_each_row<RosterRow>(stmt, [&entries](const RosterRow& row) {
+			entries.push_back(RosterCache::make_entry(row.id, row.name, row.class_no, row.score, row.able));
+		});
+		return crow::response(200);
+	};
+}
+
+// 用 threads 个读线程跑 seconds 秒，返回每秒完成的读请求数
+double run(const string& path, int threads, double seconds, int students, int& errors) {
+	IoService io;
+	IoService::work work(io);
+	DbExecutor readers(path, threads);
+
+	vector<unique_ptr<Call>> calls;
+	int next = 0;
+	auto submit = [&](Call& call) {
+		call.res.clear();
+		readers.submit(call.req, call.res, read_job(next++, students));
+	};
+	for (int i = 0; i < threads * kInFlightPerThread; i++) {
+		calls.push_back(make_unique<Call>());
+		calls.back()->req.io_service = &io;
+		submit(*calls.back());
+	}
+
+	long done = 0;
+	bench::Stopwatch sw;
+	while (sw.seconds() < seconds) {
+		io.run_one();
+		for (auto& call : calls) {
+			if (!call->res.is_completed())
+				continue;
+			done++;
+			if (call->res.code >= 400)
+				errors++;
+			submit(*call);
+		}
+	}
+	double elapsed = sw.seconds();
+
+	// 等还在排队的请求结束，它们引用着 calls
+	auto pending = [&calls] {
+		return any_of(calls.begin(), calls.end(), [](const unique_ptr<Call>& c) { return !c->res.is_completed(); });
+	};
+	while (pending())
+		io.run_one();
+	return done / elapsed;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	int max_threads = bench::arg_int(argc, argv, 1, max(2u, thread::hardware_concurrency()));
+	int students = bench::arg_int(argc, argv, 2, 20000);
+	int seconds = bench::arg_int(argc, argv, 3, 2);
+	string path = "pool_bench.db";
+
+	// 旧结构的数据库升级到最新版本，每个学生选两门课
+	bench::create_legacy_db(path, students, kCourses);
+	{
+		Connection conn(path);
+		run_migrations(conn);
+	}
+
+	cout << "threads\treads/s\t\tspeedup\terrors" << endl;
+	double base = 0;
+	for (int threads = 1; threads <= max_threads; threads++) {
+		int errors = 0;
+		double reads = run(path, threads, seconds, students, errors);
+		if (threads == 1)
+			base = reads;
+		cout << threads << "\t" << long(reads) << "\t\t" << reads / base << "x\t" << errors << endl;
+	}
+
+	remove(path.c_str());
+	remove((path + "-wal").c_str());
+	remove((path + "-shm").c_str());
+	return 0;
+}
@@ -0,0 +1,77 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+// RecordCache 快照的读吞吐量随线程数的变化，同时有一个线程像写线程那样不停地刷新记录。
+// 读不加锁（见 snapshot_ptr.h），在多核机器上吞吐量应当随线程数接近线性增长；
+// 线程数超过核数之后只是分时运行，总吞吐量不会再增加。
+// 用法: snapshot_bench [最大线程数] [学生数] [每轮秒数]
+
+#include "bench_common.h"
+#include "connection.h"
+#include "migrations.h"
+#include "record_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+int main(int argc, char** argv) {
+	int max_threads = bench::arg_int(argc, argv, 1, max(2u, thread::hardware_concurrency()));
+	int students = bench::arg_int(argc, argv, 2, 100000);
+	int seconds = bench::arg_int(argc, argv, 3, 2);
+	string path = "snapshot_bench.db";
+
+	bench::create_legacy_db(path, students, 50);
+	Connection conn(path);
+	run_migrations(conn);
+
+	RecordCache cache;
+	bench::Stopwatch sw;
+	cache.load_all(conn);
+	cout << "loaded " << cache.size() << " records in " << sw.seconds() << " s" << endl;
+
+	cout << "threads\treads/s\t\tper thread\trefreshes/s" << endl;
+	for (int threads = 1; threads <= max_threads; threads *= 2) {
+		atomic<bool> stop{false};
+		atomic<long> total{0};
+		long refreshes = 0;
+
+		vector<thread> workers;
+		for (int t = 0; t < threads; t++) {
+			workers.emplace_back([&, t] {
+				long n = 0;
+				for (int i = t * 7919; !stop.load(memory_order_relaxed); i++, n++) {
+					auto record = cache.get_student(i % students + 1);
+					if (!record)
+						abort();
+				}
+				total += n;
+			});
+		}
+
+		// 模拟写线程提交后逐条刷新
+		thread writer([&] {
+			for (int i = 0; !stop.load(memory_order_relaxed); i++, refreshes++)
+				cache.refresh_student(conn, i % students + 1);
+		});
+
+		this_thread::sleep_for(chrono::seconds(seconds));
+		stop = true;
+		for (auto& w : workers)
+			w.join();
+		writer.join();
+
+		double reads = double(total) / seconds;
+		cout << threads << "\t" << long(reads) << "\t" << long(reads / threads) << "\t" << refreshes / seconds << endl;
+	}
+
+	remove(path.c_str());
+	return 0;
+}
@@ -0,0 +1,41 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+// /course_stats 在一列成绩上计算统计量的耗时，其中约10%是还没录入的 -1。
+// 用法: stats_bench [人数] [次数]
+
+#include "bench_common.h"
+#include "course_stats.h"
+
+#include <random>
+#include <vector>
+
+using namespace std;
+
+int main(int argc, char** argv) {
+	int students = bench::arg_int(argc, argv, 1, 100000);
+	int rounds = bench::arg_int(argc, argv, 2, 1000);
+
+	mt19937 rng(42);
+	normal_distribution<double> score(75, 12);
+	uniform_int_distribution<int> ungraded(0, 9);
+	vector<int32_t> scores(students);
+	for (auto& s : scores)
+		s = ungraded(rng) == 0 ? -1 : max(0, min(100, int(score(rng))));
+
+	ScoreStats stats;
+	bench::Stopwatch sw;
+	for (int i = 0; i < rounds; i++)
+		stats = compute_score_stats(scores.data(), scores.size());
+	double us = sw.micros() / rounds;
+
+	cout << students << " students, " << stats.count << " graded" << endl;
+	cout << "mean " << stats.mean << ", stddev " << stats.stddev << ", median " << stats.median
+		<< ", p90 " << stats.p90 << ", min " << stats.min << ", max " << stats.max << endl;
+	cout << us << " us per course" << endl;
+	return 0;
+}
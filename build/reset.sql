@@ -1 +1,2 @@
-UPDATE student SET score1 = -1,   score2 = -1, phone_number = "-1", gender = -1, wish = "保内", able_to_revise1 = 1, able_to_revise2 = 1 ;
+UPDATE students SET phone_number = "-1", gender = -1, wish = "保内";
+UPDATE enrollments SET score = -1, able_to_revise = 1;
@@ -330,6 +330,25 @@ namespace crow
             }
         }
 
+        /// \brief Get the number of connections each worker io_service is handling (empty before the server starts)
+        std::vector<unsigned int> task_queue_lengths()
+        {
+            if (!server_started_)
+            {
+                return {};
+            }
+#ifdef CROW_ENABLE_SSL
+            if (ssl_used_)
+            {
+                return ssl_server_->task_queue_lengths();
+            }
+            else
+#endif
+            {
+                return server_->task_queue_lengths();
+            }
+        }
+
         /// \brief Set the connection timeout in seconds (default is 5)
         self_t& timeout(std::uint8_t timeout)
         {
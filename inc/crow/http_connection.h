@@ -77,6 +77,9 @@ namespace crow
 
         ~Connection()
         {
+            // Counterpart of the increment in Server::do_accept; without it the per-io_service
+            // counts only ever grow and pick_io_service_idx balances by lifetime accepts.
+            queue_length_--;
 #ifdef CROW_ENABLE_DEBUG
             connectionCount--;
             CROW_LOG_DEBUG << "Connection (" << this << ") freed, total: " << connectionCount;
@@ -216,6 +219,10 @@ namespace crow
         /// Call the after handle middleware and send the write the response to the connection.
         void complete_request()
         {
+            // When res.end() is called asynchronously the completion handler may hold the last
+            // reference to this connection, and prepare_buffers() clears that handler.
+            auto self = this->shared_from_this();
+
             CROW_LOG_INFO << "Response: " << this << ' ' << req_.raw_url << ' ' << res.code << ' ' << close_connection_;
             res.is_alive_helper_ = nullptr;
 
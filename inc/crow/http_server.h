@@ -204,6 +204,16 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                 cv_started_.wait(lock);
         }
 
+        /// Connections handled by each worker io_service (the same counters used to pick one in do_accept).
+        /// The socket currently waiting in async_accept is counted too.
+        std::vector<unsigned int> task_queue_lengths() const
+        {
+            std::vector<unsigned int> lengths;
+            for (const auto& length : task_queue_length_pool_)
+                lengths.push_back(length.load(std::memory_order_relaxed));
+            return lengths;
+        }
+
         void signal_clear()
         {
             signals_.clear();
@@ -249,6 +259,11 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                   [this, p, &is, service_idx](error_code ec) {
                       if (!ec)
                       {
+                          // Responses larger than the stream threshold are written in several
+                          // synchronous chunks; with Nagle enabled every chunk after the first on a
+                          // keep-alive connection waits for the client's delayed ACK (~40ms).
+                          error_code nodelay_ec;
+                          p->socket().set_option(asio::ip::tcp::no_delay(true), nodelay_ec);
                           is.post(
                             [p] {
                                 p->start();
@@ -256,7 +271,7 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                       }
                       else
                       {
-                          task_queue_length_pool_[service_idx]--;
+                          // The count is given back when p (the unused Connection) is destroyed.
                           CROW_LOG_DEBUG << &is << " {" << service_idx << "} queue length: " << task_queue_length_pool_[service_idx];
                       }
                       do_accept();
@@ -0,0 +1,166 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#include "approvals.h"
+#include "enrollments.h"
+#include "repository.h"
+
+#include <iostream>
+
+using namespace std;
+
+ApprovalResult approve_teacher_request(Connection& conn, const string& req_id) {
+	ApprovalResult result;
+	sqlite3* db = conn.get();
+
+	string option, req_course_id;
+	{
+		static const string sql = "DELETE FROM requests_teacher WHERE req_id = ? RETURNING " + columns_sql<ScoreChangeRequest>() + ";";
+		auto stmt = conn.prepare(sql);
+		if (!stmt) {
+			cerr << "SQL error: " << sqlite3_errmsg(db) << endl;
+			return result;
+		}
+
+		sqlite3_bind_text(stmt, 1, req_id.c_str(), -1, SQLITE_STATIC);
+		int rc = sqlite3_step(stmt);
+		if (rc == SQLITE_DONE) {
+			result.status = ApprovalStatus::NotFound;
+			return result;
+		}
+		if (rc != SQLITE_ROW) {
+			cerr << "DELETE error: " << sqlite3_errmsg(db) << endl;
+			return result;
+		}
+
+		// 文本列指向SQLite的内存，下一次 step 之前拷贝出来
+		ScoreChangeRequest row;
+		decode(stmt, row);
+		result.stu_id = row.stu_id;
+		option = row.option;
+		result.score = row.new_score;
+		req_course_id = row.course_id;
+
+		// req_id是主键，只会返回一行，再执行一步让语句结束
+		if (sqlite3_step(stmt) != SQLITE_DONE) {
+			cerr << "DELETE error: " << sqlite3_errmsg(db) << endl;
+			return result;
+		}
+	}
+
+	// 老版本留下的申请可能只有 score1/score2，没有课程号
+	if (!resolve_course(conn, result.stu_id, req_course_id, option, result.course_id)) {
+		result.status = ApprovalStatus::InvalidOption;
+		return result;
+	}
+
+	auto update_stmt = conn.prepare("UPDATE enrollments SET score = ? WHERE student_id = ? AND course_id = ?;");
+	if (!update_stmt) {
+		cerr << "Update SQL error: " << sqlite3_errmsg(db) << endl;
+		return result;
+	}
+	sqlite3_bind_int(update_stmt, 1, result.score);
+	sqlite3_bind_int(update_stmt, 2, result.stu_id);
+	sqlite3_bind_text(update_stmt, 3, result.course_id.c_str(), -1, SQLITE_STATIC);
+	if (sqlite3_step(update_stmt) != SQLITE_DONE) {
+		cerr << "Update error: " << sqlite3_errmsg(db) << endl;
+		return result;
+	}
+	// 学生已经退了这门课（或者申请里的课程号不对）时什么也没改，不能当成功，否则申请被删了成绩却没变
+	if (sqlite3_changes(db) == 0) {
+		result.status = ApprovalStatus::InvalidOption;
+		return result;
+	}
+
+	result.status = ApprovalStatus::Ok;
+	return result;
+}
+
+ApprovalResult approve_student_request(Connection& conn, const string& req_id) {
+	ApprovalResult result;
+	sqlite3* db = conn.get();
+
+	int gender;
+	string phone_number, wish;
+	{
+		static const string sql = "DELETE FROM requests_student WHERE req_id = ? RETURNING " + columns_sql<InfoChangeRequest>() + ";";
+		auto stmt = conn.prepare(sql);
+		if (!stmt) {
+			cerr << "SQL error: " << sqlite3_errmsg(db) << endl;
+			return result;
+		}
+
+		sqlite3_bind_text(stmt, 1, req_id.c_str(), -1, SQLITE_STATIC);
+		int rc = sqlite3_step(stmt);
+		if (rc == SQLITE_DONE) {
+			result.status = ApprovalStatus::NotFound;
+			return result;
+		}
+		if (rc != SQLITE_ROW) {
+			cerr << "DELETE error: " << sqlite3_errmsg(db) << endl;
+			return result;
+		}
+
+		InfoChangeRequest row;
+		decode(stmt, row);
+		result.stu_id = row.id;
+		gender = row.gender;
+		phone_number = row.phone_number;
+		wish = row.wish;
+
+		if (sqlite3_step(stmt) != SQLITE_DONE) {
+			cerr << "DELETE error: " << sqlite3_errmsg(db) << endl;
+			return result;
+		}
+	}
+
+	auto update_stmt = conn.prepare("UPDATE students SET gender = ?, phone_number = ?, wish = ? WHERE id = ?;");
+	if (!update_stmt) {
+		cerr << "Update SQL error: " << sqlite3_errmsg(db) << endl;
+		return result;
+	}
+	sqlite3_bind_int(update_stmt, 1, gender);
+	sqlite3_bind_text(update_stmt, 2, phone_number.c_str(), -1, SQLITE_STATIC);
+	sqlite3_bind_text(update_stmt, 3, wish.c_str(), -1, SQLITE_STATIC);
+	sqlite3_bind_int(update_stmt, 4, result.stu_id);
+	if (sqlite3_step(update_stmt) != SQLITE_DONE) {
+		cerr << "Update error: " << sqlite3_errmsg(db) << endl;
+		return result;
+	}
+	// 申请里的学生已经不存在
+	if (sqlite3_changes(db) == 0) {
+		result.status = ApprovalStatus::NotFound;
+		return result;
+	}
+
+	result.status = ApprovalStatus::Ok;
+	return result;
+}
+
+ApprovalStatus reject_request(Connection& conn, const string& req_type, const string& req_id) {
+	const char* sql;
+	if (req_type == "teacher")
+		sql = "DELETE FROM requests_teacher WHERE req_id = ?;";
+	else if (req_type == "student")
+		sql = "DELETE FROM requests_student WHERE req_id = ?;";
+	else
+		return ApprovalStatus::NotFound;
+
+	auto stmt = conn.prepare(sql);
+	if (!stmt) {
+		cerr << "Delete SQL error: " << sqlite3_errmsg(conn.get()) << endl;
+		return ApprovalStatus::DbError;
+	}
+
+	sqlite3_bind_text(stmt, 1, req_id.c_str(), -1, SQLITE_STATIC);
+	if (sqlite3_step(stmt) != SQLITE_DONE) {
+		cerr << "Delete error: " << sqlite3_errmsg(conn.get()) << endl;
+		return ApprovalStatus::DbError;
+	}
+
+	return sqlite3_changes(conn.get()) ? ApprovalStatus::Ok : ApprovalStatus::NotFound;
+}
@@ -0,0 +1,45 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#pragma once
+
+#include "connection.h"
+#include <string>
+
+/*
+ 管理员审核申请（/unsolvereq）的数据库操作，只能在写线程的任务里调用（见 db_writer.h）。
+
+ 确认一条申请只需要两条语句：
+	1. DELETE ... RETURNING 按req_id主键取出并删除这条申请
+	2. 把申请的内容写进 enrollments / students
+ 两条语句都在写线程的事务里执行，第2步失败或者一行都没改到时返回的不是 Ok，任务返回 >= 400，
+ 删除也随之回滚，不会出现申请被删了修改却没生效的情况。语句由 Connection 缓存，重复审核时不用重新编译SQL。
+*/
+
+enum class ApprovalStatus {
+	Ok,
+	NotFound,      // 没有这条申请（可能已经被别人处理了），或者申请里的学生已经不存在
+	InvalidOption, // 老师申请里的 score1/score2 找不到对应的课程，或者学生没有选这门课
+	DbError,
+};
+
+struct ApprovalResult {
+	ApprovalStatus status = ApprovalStatus::DbError;
+	int stu_id = 0;
+	// 下面两项只有老师申请才有：改的是哪门课、改成多少分
+	std::string course_id;
+	int score = 0;
+};
+
+// 确认老师的改分申请：修改这个学生这门课的成绩
+ApprovalResult approve_teacher_request(Connection& conn, const std::string& req_id);
+
+// 确认学生的信息修改申请：修改学生的性别、电话和意向
+ApprovalResult approve_student_request(Connection& conn, const std::string& req_id);
+
+// 驳回申请，直接删除。req_type 是 "teacher" 或 "student"
+ApprovalStatus reject_request(Connection& conn, const std::string& req_type, const std::string& req_id);
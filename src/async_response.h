@@ -0,0 +1,30 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#pragma once
+
+#include "crow.h"
+#include <memory>
+#include <utility>
+
+/*
+ 在其他线程（写线程、数据库线程池）算出结果后，用它来结束异步handler的响应。
+ crow::response::end() 不是线程安全的，要回到这个连接所在的io_service线程上调用。
+ 没有io_service的请求（比如测试里直接调用 handle_full）就直接在当前线程结束。
+*/
+inline void complete_response(const crow::request& req, crow::response& res, crow::response result) {
+	auto result_ptr = std::make_shared<crow::response>(std::move(result));
+	auto finish = [&res, result_ptr] {
+		res = std::move(*result_ptr);
+		res.end();
+	};
+
+	if (req.io_service)
+		req.io_service->post(finish);
+	else
+		finish();
+}
@@ -0,0 +1,194 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#include "backup.h"
+
+#include <sqlite3.h>
+#include <algorithm>
+#include <ctime>
+#include <filesystem>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+
+// 打开的 sqlite3*，出作用域自动关闭
+struct SqliteHandle {
+	sqlite3* db = nullptr;
+	~SqliteHandle() { sqlite3_close(db); }
+};
+
+string backup_file_name() {
+	time_t now = time(nullptr);
+	tm local;
+	localtime_r(&now, &local);
+	char name[32];
+	strftime(name, sizeof(name), "info-%Y%m%d-%H%M%S.db", &local);
+	return name;
+}
+
+} // namespace
+
+DbBackup::DbBackup(string db_path, string dir, const LatencyHistogram* latency, int pages_per_step,
+		chrono::milliseconds pause, size_t keep)
+	: db_path_(move(db_path)), dir_(move(dir)), latency_(latency), pages_per_step_(pages_per_step), pause_(pause), keep_(keep),
+	  started_(chrono::steady_clock::now()) {}
+
+DbBackup::~DbBackup() {
+	stop_ = true;
+	if (thread_.joinable())
+		thread_.join();
+}
+
+bool DbBackup::start() {
+	lock_guard<mutex> lock(mtx_);
+	if (status_.running)
+		return false;
+	// 上一次备份的线程已经结束了，只是还没有 join
+	if (thread_.joinable())
+		thread_.join();
+
+	string file = dir_ + "/" + backup_file_name();
+	status_.running = true;
+	status_.file = file;
+	status_.error.clear();
+	status_.page_count = status_.remaining = 0;
+	status_.steps = 0;
+	status_.started_at = time(nullptr);
+	status_.seconds = 0;
+	status_.p99_during_ms = 0;
+	status_.requests_during = 0;
+	if (latency_) {
+		latency_before_ = latency_->snapshot();
+		status_.p99_before_ms = LatencyHistogram::percentile(latency_before_, 0.99);
+	}
+	started_ = chrono::steady_clock::now();
+
+	thread_ = thread(&DbBackup::run, this, move(file));
+	return true;
+}
+
+void DbBackup::start_if_due(chrono::seconds interval) {
+	{
+		lock_guard<mutex> lock(mtx_);
+		if (chrono::steady_clock::now() - started_ < interval)
+			return;
+	}
+	start();
+}
+
+BackupStatus DbBackup::status() {
+	lock_guard<mutex> lock(mtx_);
+	BackupStatus result = status_;
+	if (result.running) {
+		result.seconds = chrono::duration<double>(chrono::steady_clock::now() - started_).count();
+		if (latency_) {
+			auto during = LatencyHistogram::difference(latency_->snapshot(), latency_before_);
+			result.p99_during_ms = LatencyHistogram::percentile(during, 0.99);
+			result.requests_during = LatencyHistogram::count(during);
+		}
+	}
+	return result;
+}
+
+void DbBackup::run(string file) {
+	string tmp = file + ".tmp";
+	string error;
+	try {
+		error_code ec;
+		fs::create_directories(dir_, ec);
+		if (ec)
+			throw runtime_error("Can't create " + dir_ + ": " + ec.message());
+
+		SqliteHandle source, dest;
+		if (sqlite3_open_v2(db_path_.c_str(), &source.db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK)
+			throw runtime_error(string("Can't open ") + db_path_ + ": " + sqlite3_errmsg(source.db));
+		if (sqlite3_open(tmp.c_str(), &dest.db) != SQLITE_OK)
+			throw runtime_error(string("Can't create ") + tmp + ": " + sqlite3_errmsg(dest.db));
+		sqlite3_busy_timeout(source.db, 5000);
+
+		// 固定快照，见 backup.h
+		if (sqlite3_exec(source.db, "BEGIN; SELECT count(*) FROM sqlite_schema;", nullptr, nullptr, nullptr) != SQLITE_OK)
+			throw runtime_error(sqlite3_errmsg(source.db));
+
+		sqlite3_backup* backup = sqlite3_backup_init(dest.db, "main", source.db, "main");
+		if (!backup)
+			throw runtime_error(sqlite3_errmsg(dest.db));
+
+		int rc;
+		while (true) {
+			rc = sqlite3_backup_step(backup, pages_per_step_);
+			{
+				lock_guard<mutex> lock(mtx_);
+				status_.steps++;
+				status_.page_count = sqlite3_backup_pagecount(backup);
+				status_.remaining = sqlite3_backup_remaining(backup);
+			}
+			if (rc == SQLITE_DONE || (rc != SQLITE_OK && rc != SQLITE_BUSY && rc != SQLITE_LOCKED) || stop_)
+				break;
+			this_thread::sleep_for(pause_);
+		}
+		sqlite3_backup_finish(backup);
+		sqlite3_exec(source.db, "COMMIT;", nullptr, nullptr, nullptr);
+
+		if (stop_ && rc != SQLITE_DONE)
+			throw runtime_error("Stopped");
+		if (rc != SQLITE_DONE)
+			throw runtime_error(sqlite3_errstr(rc));
+	} catch (const exception& e) {
+		error = e.what();
+	}
+
+	if (error.empty()) {
+		error_code ec;
+		fs::rename(tmp, file, ec);
+		if (ec)
+			error = "Can't rename " + tmp + ": " + ec.message();
+	}
+	if (error.empty())
+		remove_old_backups();
+	else {
+		error_code ec;
+		fs::remove(tmp, ec);
+		CROW_LOG_ERROR << "Backup failed: " << error;
+	}
+
+	lock_guard<mutex> lock(mtx_);
+	status_.running = false;
+	status_.error = error;
+	status_.seconds = chrono::duration<double>(chrono::steady_clock::now() - started_).count();
+	if (latency_) {
+		auto during = LatencyHistogram::difference(latency_->snapshot(), latency_before_);
+		status_.p99_during_ms = LatencyHistogram::percentile(during, 0.99);
+		status_.requests_during = LatencyHistogram::count(during);
+	}
+	if (error.empty()) {
+		status_.completed++;
+		CROW_LOG_INFO << "Backup " << file << " finished in " << status_.seconds << "s, " << status_.page_count << " pages, p99 "
+			<< status_.p99_before_ms << "ms before / " << status_.p99_during_ms << "ms during";
+	}
+}
+
+void DbBackup::remove_old_backups() {
+	// 文件名里的时间戳按字典序就是时间顺序
+	vector<fs::path> backups;
+	error_code ec;
+	for (fs::directory_iterator it(dir_, ec), end; !ec && it != end; it.increment(ec)) {
+		const fs::path& path = it->path();
+		if (path.extension() == ".db" && path.filename().string().rfind("info-", 0) == 0)
+			backups.push_back(path);
+	}
+	if (backups.size() <= keep_)
+		return;
+
+	sort(backups.begin(), backups.end());
+	for (size_t i = 0; i + keep_ < backups.size(); i++)
+		fs::remove(backups[i], ec);
+}
@@ -0,0 +1,83 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#pragma once
+
+#include "latency.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/*
+ 在线热备份。服务器运行时直接复制 info.db 不安全（写线程可能正写到一半，WAL里还有没合并的页），
+ 这里用 sqlite3_backup_step 在后台线程里一段一段地复制：每次复制 pages_per_step 页，然后休息 pause，
+ 所以备份期间写线程只是偶尔和它抢一下磁盘，前台请求的延迟基本不受影响。
+
+ 备份开始时在源连接上开一个读事务，一直到复制结束。WAL模式下读事务不挡写，
+ 而且整个备份看到的是同一个快照：其他连接中途提交不会让备份从头再来，备份文件就是开始那一刻的数据库。
+ 代价是备份期间WAL的检查点不能越过这个快照，-wal 文件会比平时大一些。
+
+ 先写到 backups/xxx.db.tmp，完成后再改名，只保留最近 keep 个备份。
+*/
+
+struct BackupStatus {
+	bool running = false;
+	std::string file;       // 正在写或最后一次完成的备份
+	std::string error;      // 最后一次失败的原因
+	int page_count = 0;
+	int remaining = 0;
+	std::size_t steps = 0;
+	std::int64_t started_at = 0; // unix时间戳（秒）
+	double seconds = 0;          // 已经用了 / 一共用了多少秒
+	// 备份开始前（从服务器启动算起）和备份期间所有请求的p99，单位毫秒
+	double p99_before_ms = 0;
+	double p99_during_ms = 0;
+	std::uint64_t requests_during = 0;
+	std::size_t completed = 0;   // 启动以来成功完成的备份数
+};
+
+class DbBackup {
+public:
+	// latency 为空时不统计备份对延迟的影响
+	DbBackup(std::string db_path, std::string dir, const LatencyHistogram* latency = nullptr,
+		int pages_per_step = 256, std::chrono::milliseconds pause = std::chrono::milliseconds(10), std::size_t keep = 7);
+	~DbBackup();
+
+	DbBackup(const DbBackup&) = delete;
+	DbBackup& operator=(const DbBackup&) = delete;
+
+	// 在后台开始一次备份，已经有备份在进行时返回 false
+	bool start();
+
+	// 距离上一次备份开始（还没有备份过时从服务器启动算起）已经超过 interval 就开始一次，给 app.tick 定时调用
+	void start_if_due(std::chrono::seconds interval);
+
+	BackupStatus status();
+
+private:
+	void run(std::string file);
+	void remove_old_backups();
+
+	std::string db_path_;
+	std::string dir_;
+	const LatencyHistogram* latency_;
+	int pages_per_step_;
+	std::chrono::milliseconds pause_;
+	std::size_t keep_;
+
+	std::mutex mtx_;
+	BackupStatus status_;
+	LatencyHistogram::Snapshot latency_before_{};
+	std::chrono::steady_clock::time_point started_;
+	std::thread thread_;
+	std::atomic<bool> stop_{false};
+};
@@ -0,0 +1,38 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#include "batch_progress.h"
+
+#include <algorithm>
+
+using namespace std;
+
+shared_ptr<BatchProgress::Counter> BatchProgress::start(const string& batch_id, size_t total) {
+	auto counter = make_shared<Counter>(total);
+
+	lock_guard<mutex> lock(mtx_);
+	if (batches_.count(batch_id))
+		order_.erase(find(order_.begin(), order_.end(), batch_id));
+	batches_[batch_id] = counter;
+	order_.push_back(batch_id);
+
+	while (order_.size() > max_batches_) {
+		batches_.erase(order_.front());
+		order_.pop_front();
+	}
+	return counter;
+}
+
+optional<BatchProgress::Status> BatchProgress::get(const string& batch_id) {
+	lock_guard<mutex> lock(mtx_);
+	auto it = batches_.find(batch_id);
+	if (it == batches_.end())
+		return nullopt;
+
+	const Counter& c = *it->second;
+	return Status{c.total, c.done.load(memory_order_relaxed), c.finished.load(memory_order_acquire)};
+}
@@ -0,0 +1,52 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+/*
+ 批量操作的进度。Crow的响应体只能一次性返回，不能边处理边往外写，
+ 所以很大的一批在处理时，客户端带着自己起的 batch_id 另外轮询进度。
+ 只保留最近的 max_batches 批，旧的自动丢弃。
+*/
+class BatchProgress {
+public:
+	struct Counter {
+		explicit Counter(std::size_t total) : total(total) {}
+		const std::size_t total;
+		std::atomic<std::size_t> done{0};
+		std::atomic<bool> finished{false};
+	};
+
+	struct Status {
+		std::size_t total;
+		std::size_t done;
+		bool finished;
+	};
+
+	explicit BatchProgress(std::size_t max_batches = 64) : max_batches_(max_batches) {}
+
+	// 登记一批，同名的旧记录会被覆盖。处理的线程通过返回的计数器更新进度
+	std::shared_ptr<Counter> start(const std::string& batch_id, std::size_t total);
+
+	// 没有这一批（或者已经被丢弃）时返回空
+	std::optional<Status> get(const std::string& batch_id);
+
+private:
+	std::size_t max_batches_;
+	std::mutex mtx_;
+	std::unordered_map<std::string, std::shared_ptr<Counter>> batches_;
+	std::deque<std::string> order_; // 登记的先后顺序，用来丢弃最旧的
+};
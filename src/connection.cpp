@@ -0,0 +1,90 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#include "connection.h"
+#include <stdexcept>
+
+using namespace std;
+
+Connection::Connection(const string& path) {
+	// 每个连接同一时刻只属于一个线程，所以用 NOMUTEX 关掉SQLite自己的连接锁
+	int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX;
+	int rc = sqlite3_open_v2(path.c_str(), &db_, flags, nullptr);
+	if (rc != SQLITE_OK) {
+		string msg = db_ ? sqlite3_errmsg(db_) : "out of memory";
+		sqlite3_close(db_);
+		db_ = nullptr;
+		throw runtime_error("Can't open database: " + msg);
+	}
+
+	// 多个连接同时写时，遇到锁先等一会儿，而不是立刻返回 SQLITE_BUSY
+	sqlite3_busy_timeout(db_, 5000);
+}
+
+Connection::~Connection() {
+	for (auto& entry : stmt_cache_)
+		for (sqlite3_stmt* stmt : entry.second)
+			sqlite3_finalize(stmt);
+	sqlite3_close(db_);
+}
+
+Statement Connection::prepare(const string& sql) {
+	auto it = stmt_cache_.try_emplace(sql).first;
+	auto& idle = it->second;
+
+	if (!idle.empty()) {
+		sqlite3_stmt* stmt = idle.back();
+		idle.pop_back();
+		return Statement(this, &it->first, stmt);
+	}
+
+	// 缓存里的语句会长期存在，告诉SQLite不要从lookaside小内存池里给它分配
+	sqlite3_stmt* stmt = nullptr;
+	int rc = sqlite3_prepare_v3(db_, sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr);
+	if (rc != SQLITE_OK) {
+		sqlite3_finalize(stmt);
+		return Statement();
+	}
+	return Statement(this, &it->first, stmt);
+}
+
+void Connection::give_back(const string& sql, sqlite3_stmt* stmt) {
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+	stmt_cache_[sql].push_back(stmt);
+}
+
+Statement::~Statement() {
+	if (stmt_)
+		conn_->give_back(*sql_, stmt_);
+}
+
+Transaction::Transaction(Connection& conn) : conn_(conn) {
+	active_ = exec("BEGIN IMMEDIATE;");
+}
+
+Transaction::~Transaction() {
+	if (active_)
+		exec("ROLLBACK;");
+}
+
+bool Transaction::commit() {
+	if (!active_)
+		return false;
+	active_ = false;
+	if (exec("COMMIT;"))
+		return true;
+
+	// COMMIT失败时事务仍然是打开的，需要手动回滚
+	exec("ROLLBACK;");
+	return false;
+}
+
+bool Transaction::exec(const char* sql) {
+	auto stmt = conn_.prepare(sql);
+	return stmt && sqlite3_step(stmt) == SQLITE_DONE;
+}
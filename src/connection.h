@@ -0,0 +1,91 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#pragma once
+
+#include <sqlite3.h>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Connection;
+
+/*
+ 从连接的语句缓存里借出来的预处理语句，析构时 reset 并清空绑定，然后放回缓存。
+ 可以隐式转换成 sqlite3_stmt*，所以 sqlite3_bind_* / sqlite3_step / sqlite3_column_* 直接传它就行。
+ 预处理失败时为空，用 if (!stmt) 判断。
+*/
+class Statement {
+public:
+	Statement() = default;
+	Statement(Connection* conn, const std::string* sql, sqlite3_stmt* stmt) : conn_(conn), sql_(sql), stmt_(stmt) {}
+	Statement(Statement&& other) noexcept : conn_(other.conn_), sql_(other.sql_), stmt_(other.stmt_) { other.stmt_ = nullptr; }
+	Statement(const Statement&) = delete;
+	Statement& operator=(const Statement&) = delete;
+	~Statement();
+
+	sqlite3_stmt* get() const { return stmt_; }
+	operator sqlite3_stmt*() const { return stmt_; }
+
+private:
+	Connection* conn_ = nullptr;
+	const std::string* sql_ = nullptr;
+	sqlite3_stmt* stmt_ = nullptr;
+};
+
+// 一个SQLite连接，同一时刻只会被一个线程使用
+class Connection {
+public:
+	explicit Connection(const std::string& path);
+	~Connection();
+
+	Connection(const Connection&) = delete;
+	Connection& operator=(const Connection&) = delete;
+
+	sqlite3* get() const { return db_; }
+
+	/*
+	 按SQL文本从缓存中取一条编译好的语句，没有就编译一条。
+	 同一条SQL第二次用时不再调用 sqlite3_prepare_v2，只需要重新绑定参数。
+	 注意sql应当是固定的文本（参数用?绑定），不要把用户数据拼进去，否则缓存会无限增长。
+	*/
+	Statement prepare(const std::string& sql);
+
+private:
+	friend class Statement;
+	void give_back(const std::string& sql, sqlite3_stmt* stmt);
+
+	sqlite3* db_ = nullptr;
+
+	// SQL文本 -> 空闲的语句。同一条SQL可能被嵌套借出多次，所以每个key存一组
+	std::unordered_map<std::string, std::vector<sqlite3_stmt*>> stmt_cache_;
+};
+
+/*
+ 事务：构造时执行 BEGIN IMMEDIATE（立刻拿写锁，避免中途升级锁失败），
+ 调用 commit() 提交；没有提交就析构时自动 ROLLBACK，保证要么全部成功要么全部不生效。
+*/
+class Transaction {
+public:
+	explicit Transaction(Connection& conn);
+	~Transaction();
+
+	Transaction(const Transaction&) = delete;
+	Transaction& operator=(const Transaction&) = delete;
+
+	// BEGIN 是否成功
+	bool ok() const { return active_; }
+	bool commit();
+
+private:
+	bool exec(const char* sql);
+
+	Connection& conn_;
+	bool active_ = false;
+};
@@ -0,0 +1,71 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#include "course_aggregates.h"
+#include "crow/logging.h"
+
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+// 从 enrollments 重新统计的结果，列的顺序和两张表相同
+const char* expected_aggregates_sql =
+	"SELECT course_id, COUNT(*), SUM(score >= 0), SUM((score >= 0) * score), SUM((score >= 0) * score * score) "
+	"FROM enrollments GROUP BY course_id";
+const char* expected_histogram_sql =
+	"SELECT course_id, MIN(score / 10, 9), COUNT(*) FROM enrollments WHERE score >= 0 "
+	"GROUP BY course_id, MIN(score / 10, 9)";
+
+void exec(Connection& conn, const string& sql) {
+	char* err = nullptr;
+	if (sqlite3_exec(conn.get(), sql.c_str(), nullptr, nullptr, &err) != SQLITE_OK) {
+		string msg = err ? err : sqlite3_errmsg(conn.get());
+		sqlite3_free(err);
+		throw runtime_error("Course aggregates: " + msg);
+	}
+}
+
+// 两边互相 EXCEPT，都为空才一致
+long long differences(Connection& conn, const string& table, const string& expected) {
+	string sql = "SELECT (SELECT COUNT(*) FROM (SELECT * FROM " + table + " EXCEPT " + expected + "))"
+		" + (SELECT COUNT(*) FROM (" + expected + " EXCEPT SELECT * FROM " + table + "));";
+
+	auto stmt = conn.prepare(sql);
+	if (!stmt || sqlite3_step(stmt) != SQLITE_ROW)
+		throw runtime_error(string("Course aggregates: ") + sqlite3_errmsg(conn.get()));
+	return sqlite3_column_int64(stmt, 0);
+}
+
+} // namespace
+
+bool check_course_aggregates(Connection& conn) {
+	Transaction txn(conn);
+	if (!txn.ok())
+		throw runtime_error(string("Course aggregates: ") + sqlite3_errmsg(conn.get()));
+
+	long long diff = differences(conn, "course_aggregates", expected_aggregates_sql)
+		+ differences(conn, "course_histogram", expected_histogram_sql);
+	if (diff == 0)
+		return true;
+
+	CROW_LOG_WARNING << "Course aggregates differ from enrollments in " << diff << " rows, rebuilding";
+	rebuild_course_aggregates(conn);
+
+	if (!txn.commit())
+		throw runtime_error(string("Course aggregates: ") + sqlite3_errmsg(conn.get()));
+	return false;
+}
+
+void rebuild_course_aggregates(Connection& conn) {
+	exec(conn, "DELETE FROM course_aggregates;");
+	exec(conn, "DELETE FROM course_histogram;");
+	exec(conn, string("INSERT INTO course_aggregates ") + expected_aggregates_sql + ";");
+	exec(conn, string("INSERT INTO course_histogram ") + expected_histogram_sql + ";");
+}
@@ -0,0 +1,25 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#pragma once
+
+#include "connection.h"
+
+/*
+ 每门课的成绩汇总表 course_aggregates 和分数段表 course_histogram（见 migrations.cpp 的第4版），
+ 由 enrollments 上的触发器在修改成绩的同一个事务里增量更新，/course_summary 直接读取，不用重新统计。
+
+ 启动时用 check_course_aggregates() 和 enrollments 重新统计的结果对比一次
+ （比如有人删掉过触发器，或者用旧版本的程序改过数据库），不一致时重建两张表。
+*/
+
+// 一致时返回 true；不一致时重建并返回 false。数据库出错时抛出 std::runtime_error
+bool check_course_aggregates(Connection& conn);
+
+// 从 enrollments 重新统计，替换两张表的内容，需要在事务里调用。
+// 大批量插入选课时可以先删掉插入触发器，插完调用它一次，比逐行维护快得多
+void rebuild_course_aggregates(Connection& conn);
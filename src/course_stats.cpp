@@ -0,0 +1,203 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#include "course_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+using namespace std;
+
+namespace {
+
+// 正常的成绩范围，超出范围的（正常情况下不会有）单独排序处理
+constexpr int kMaxScore = 100;
+
+// 计数数组的下标：0 是未录入的 -1，1..101 是 0-100 分，102 是其他的值
+constexpr uint32_t kOtherBin = kMaxScore + 2;
+constexpr uint32_t kBins = kMaxScore + 3;
+
+// 没有分支地算出下标：-1 变成 0，0-100 分变成 1-101，其他的值（包括更小的负数）都落进 kOtherBin
+inline uint32_t bin_of(int32_t s) {
+	uint32_t b = static_cast<uint32_t>(s) + 1u;
+	return b <= kMaxScore + 1 ? b : kOtherBin;
+}
+
+struct Counts {
+	array<size_t, kMaxScore + 1> per_score{}; // 每个分数的人数
+	vector<int32_t> overflow;                 // 超过 kMaxScore 的成绩，已排序
+};
+
+// 按从小到大的顺序，取第 rank 个（从1开始数）有效成绩
+int value_at(const Counts& counts, size_t rank) {
+	size_t seen = 0;
+	for (int v = 0; v <= kMaxScore; v++) {
+		seen += counts.per_score[v];
+		if (seen >= rank)
+			return v;
+	}
+	return counts.overflow[rank - seen - 1];
+}
+
+// 最近秩法的百分位数
+int percentile(const Counts& counts, size_t count, int p) {
+	size_t rank = max<size_t>(1, (count * p + 99) / 100);
+	return value_at(counts, rank);
+}
+
+} // namespace
+
+/*
+ 成绩只有 0-100 这一百零一种取值，所以只扫描一遍成绩列，统计每个分数的人数，
+ 人数、和、平方和、最值、中位数、百分位数都从这 101 个计数精确算出，不用排序也不用浮点累加。
+ 扫描时用4组计数交替累加，相邻的成绩相同时不会因为写同一个计数而互相等待。
+*/
+ScoreStats compute_score_stats(const int32_t* scores, size_t n) {
+	ScoreStats stats;
+
+	uint32_t lanes[4][kBins] = {};
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		lanes[0][bin_of(scores[i])]++;
+		lanes[1][bin_of(scores[i + 1])]++;
+		lanes[2][bin_of(scores[i + 2])]++;
+		lanes[3][bin_of(scores[i + 3])]++;
+	}
+	for (; i < n; i++)
+		lanes[0][bin_of(scores[i])]++;
+
+	Counts counts;
+	size_t other = 0;
+	for (int l = 0; l < 4; l++) {
+		for (int v = 0; v <= kMaxScore; v++)
+			counts.per_score[v] += lanes[l][v + 1];
+		other += lanes[l][kOtherBin];
+	}
+
+	// 范围外的值很少见，有的时候才再扫描一遍把它们挑出来；负数都当作未录入
+	if (other) {
+		for (size_t j = 0; j < n; j++)
+			if (scores[j] > kMaxScore)
+				counts.overflow.push_back(scores[j]);
+		sort(counts.overflow.begin(), counts.overflow.end());
+	}
+
+	int64_t count = 0, sum = 0, sum_sq = 0;
+	for (int v = 0; v <= kMaxScore; v++) {
+		int64_t c = counts.per_score[v];
+		count += c;
+		sum += c * v;
+		sum_sq += c * v * v;
+	}
+	for (int32_t v : counts.overflow) {
+		count++;
+		sum += v;
+		sum_sq += int64_t(v) * v;
+	}
+
+	stats.count = count;
+	stats.ungraded = n - count;
+	if (count == 0)
+		return stats;
+
+	stats.min = value_at(counts, 1);
+	stats.max = value_at(counts, count);
+	stats.mean = double(sum) / count;
+	double variance = double(sum_sq) / count - stats.mean * stats.mean;
+	stats.stddev = sqrt(max(0.0, variance));
+
+	for (int v = 0; v <= kMaxScore; v++)
+		stats.histogram[min(v / 10, 9)] += counts.per_score[v];
+	stats.histogram[9] += counts.overflow.size();
+
+	size_t c = count;
+	if (c % 2)
+		stats.median = value_at(counts, c / 2 + 1);
+	else
+		stats.median = (value_at(counts, c / 2) + value_at(counts, c / 2 + 1)) / 2.0;
+
+	stats.p10 = percentile(counts, c, 10);
+	stats.p25 = percentile(counts, c, 25);
+	stats.p75 = percentile(counts, c, 75);
+	stats.p90 = percentile(counts, c, 90);
+	stats.p99 = percentile(counts, c, 99);
+	return stats;
+}
+
+ScoreColumns::Shard& ScoreColumns::shard_of(const string& course_id) {
+	return shards_[hash<string>()(course_id) % kShards];
+}
+
+optional<ScoreStats> ScoreColumns::stats(const string& course_id) {
+	auto& shard = shard_of(course_id);
+	shared_lock<shared_mutex> lock(shard.mtx);
+
+	auto it = shard.courses.find(course_id);
+	if (it == shard.courses.end()) {
+		misses_.fetch_add(1, memory_order_relaxed);
+		return nullopt;
+	}
+	hits_.fetch_add(1, memory_order_relaxed);
+
+	const auto& scores = it->second.scores;
+	return compute_score_stats(scores.data(), scores.size());
+}
+
+ScoreColumns::Generation ScoreColumns::generation(const string& course_id) {
+	auto& shard = shard_of(course_id);
+	shared_lock<shared_mutex> lock(shard.mtx);
+	return shard.generation;
+}
+
+ScoreStats ScoreColumns::put(const string& course_id, vector<int32_t> ids, vector<int32_t> scores, Generation gen) {
+	ScoreStats result = compute_score_stats(scores.data(), scores.size());
+
+	// 没有学生的课程不缓存，避免随便传来的课程号把缓存撑大
+	if (ids.empty())
+		return result;
+
+	auto& shard = shard_of(course_id);
+	unique_lock<shared_mutex> lock(shard.mtx);
+	if (shard.generation == gen)
+		shard.courses[course_id] = {move(ids), move(scores)};
+	return result;
+}
+
+void ScoreColumns::patch(const string& course_id, int stu_id, int score) {
+	auto& shard = shard_of(course_id);
+	unique_lock<shared_mutex> lock(shard.mtx);
+	shard.generation++;
+
+	auto it = shard.courses.find(course_id);
+	if (it == shard.courses.end())
+		return;
+
+	auto& columns = it->second;
+	auto pos = lower_bound(columns.ids.begin(), columns.ids.end(), stu_id);
+	if (pos == columns.ids.end() || *pos != stu_id) {
+		// 这门课的名单变了，下次重新加载
+		shard.courses.erase(it);
+		return;
+	}
+	columns.scores[pos - columns.ids.begin()] = score;
+}
+
+void ScoreColumns::invalidate(const string& course_id) {
+	auto& shard = shard_of(course_id);
+	unique_lock<shared_mutex> lock(shard.mtx);
+	shard.generation++;
+	shard.courses.erase(course_id);
+}
+
+void ScoreColumns::clear() {
+	for (auto& shard : shards_) {
+		unique_lock<shared_mutex> lock(shard.mtx);
+		shard.generation++;
+		shard.courses.clear();
+	}
+}
@@ -0,0 +1,283 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#include "csv_import.h"
+#include "json_writer.h"
+
+#include <charconv>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+const vector<string>& expected_header(ImportKind kind) {
+	static const vector<string> students = {"id", "name", "class", "password", "phone_number", "gender", "wish"};
+	static const vector<string> teachers = {"id", "name", "course_name", "password", "course1", "course2"};
+	static const vector<string> enrollments = {"student_id", "course_id", "score"};
+	switch (kind) {
+	case ImportKind::Students: return students;
+	case ImportKind::Teachers: return teachers;
+	default: return enrollments;
+	}
+}
+
+const char* insert_sql(ImportKind kind) {
+	switch (kind) {
+	case ImportKind::Students:
+		return "INSERT INTO students (id, name, class, password, phone_number, gender, wish) VALUES (?, ?, ?, ?, ?, ?, ?) "
+			"ON CONFLICT (id) DO UPDATE SET name = excluded.name, class = excluded.class, password = excluded.password, "
+			"phone_number = excluded.phone_number, gender = excluded.gender, wish = excluded.wish;";
+	case ImportKind::Teachers:
+		return "INSERT INTO teachers (id, name, course_name, password, course1, course2) VALUES (?, ?, ?, ?, ?, ?) "
+			"ON CONFLICT (id) DO UPDATE SET name = excluded.name, course_name = excluded.course_name, "
+			"password = excluded.password, course1 = excluded.course1, course2 = excluded.course2;";
+	default:
+		return "INSERT INTO enrollments (student_id, course_id, score) VALUES (?, ?, ?) "
+			"ON CONFLICT (student_id, course_id) DO UPDATE SET score = excluded.score;";
+	}
+}
+
+// 整个字段都是整数才算成功，允许两边有空格
+bool parse_int(const string& field, int& value) {
+	size_t begin = field.find_first_not_of(' ');
+	size_t end = field.find_last_not_of(' ');
+	if (begin == string::npos)
+		return false;
+	auto result = from_chars(field.data() + begin, field.data() + end + 1, value);
+	return result.ec == errc() && result.ptr == field.data() + end + 1;
+}
+
+// 开头是UTF-8 BOM（EF BB BF）就跳过它；只是别的 0xEF 开头的字符时，把读出来的字节放回去
+void skip_bom(streambuf& buf) {
+	char head[3];
+	streamsize n = buf.sgetn(head, 3);
+	if (n == 3 && head[0] == '\xEF' && head[1] == '\xBB' && head[2] == '\xBF')
+		return;
+	while (n > 0)
+		buf.sputbackc(head[--n]);
+}
+
+} // namespace
+
+bool parse_import_kind(const string& name, ImportKind& kind) {
+	if (name == "students")
+		kind = ImportKind::Students;
+	else if (name == "teachers")
+		kind = ImportKind::Teachers;
+	else if (name == "enrollments" || name == "scores")
+		kind = ImportKind::Enrollments;
+	else
+		return false;
+	return true;
+}
+
+bool CsvReader::next(vector<string>& fields) {
+	auto* buf = in_.rdbuf();
+	size_t count = 0;
+	auto field = [&]() -> string& {
+		if (fields.size() <= count)
+			fields.emplace_back();
+		string& f = fields[count];
+		f.clear();
+		return f;
+	};
+
+	int c = buf->sgetc();
+	if (c == char_traits<char>::eof())
+		return false;
+
+	// 跳过Excel导出的UTF-8 BOM
+	if (first_) {
+		first_ = false;
+		if (c == 0xEF)
+			skip_bom(*buf);
+	}
+
+	record_line_ = line_;
+	string* current = &field();
+	bool quoted = false;
+	while (true) {
+		c = buf->sbumpc();
+		if (c == char_traits<char>::eof())
+			break;
+
+		if (quoted) {
+			if (c == '"') {
+				if (buf->sgetc() == '"')
+					*current += static_cast<char>(buf->sbumpc());
+				else
+					quoted = false;
+			} else {
+				if (c == '\n')
+					line_++;
+				*current += static_cast<char>(c);
+			}
+			continue;
+		}
+
+		if (c == '"')
+			quoted = true;
+		else if (c == ',') {
+			count++;
+			current = &field();
+		} else if (c == '\n') {
+			line_++;
+			break;
+		} else if (c != '\r')
+			*current += static_cast<char>(c);
+	}
+
+	fields.resize(count + 1);
+	return true;
+}
+
+CsvImporter::CsvImporter(ImportKind kind, istream& in) : kind_(kind), reader_(in) {}
+
+bool CsvImporter::read_header(string& error) {
+	if (!reader_.next(fields_)) {
+		error = "Empty file";
+		return false;
+	}
+
+	const auto& expected = expected_header(kind_);
+	bool ok = fields_.size() == expected.size();
+	for (size_t i = 0; ok && i < expected.size(); i++)
+		ok = fields_[i] == expected[i];
+	if (!ok) {
+		error = "Header must be:";
+		for (size_t i = 0; i < expected.size(); i++)
+			error += (i ? "," : " ") + expected[i];
+		return false;
+	}
+	return true;
+}
+
+void CsvImporter::skip(const string& reason) {
+	stats_.skipped++;
+	if (stats_.errors.size() < ImportStats::kMaxErrors)
+		stats_.errors.push_back("line " + to_string(reader_.line()) + ": " + reason);
+}
+
+string CsvImporter::bind_row(sqlite3_stmt* stmt, sqlite3_stmt* student_exists) {
+	const auto& header = expected_header(kind_);
+	if (fields_.size() != header.size())
+		return "expected " + to_string(header.size()) + " columns, got " + to_string(fields_.size());
+
+	int id, number;
+	if (!parse_int(fields_[0], id) || id <= 0)
+		return header[0] + " must be a positive integer";
+	sqlite3_bind_int(stmt, 1, id);
+
+	switch (kind_) {
+	case ImportKind::Students:
+		sqlite3_bind_text(stmt, 2, fields_[1].c_str(), -1, SQLITE_TRANSIENT);
+		if (!parse_int(fields_[2], number))
+			return "class must be an integer";
+		sqlite3_bind_int(stmt, 3, number);
+		if (!parse_int(fields_[3], number))
+			return "password must be an integer";
+		sqlite3_bind_int(stmt, 4, number);
+		sqlite3_bind_text(stmt, 5, fields_[4].c_str(), -1, SQLITE_TRANSIENT);
+		if (!parse_int(fields_[5], number))
+			return "gender must be an integer";
+		sqlite3_bind_int(stmt, 6, number);
+		sqlite3_bind_text(stmt, 7, fields_[6].c_str(), -1, SQLITE_TRANSIENT);
+		break;
+
+	case ImportKind::Teachers:
+		sqlite3_bind_text(stmt, 2, fields_[1].c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_text(stmt, 3, fields_[2].c_str(), -1, SQLITE_TRANSIENT);
+		if (!parse_int(fields_[3], number))
+			return "password must be an integer";
+		sqlite3_bind_int(stmt, 4, number);
+		sqlite3_bind_text(stmt, 5, fields_[4].c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_text(stmt, 6, fields_[5].c_str(), -1, SQLITE_TRANSIENT);
+		break;
+
+	case ImportKind::Enrollments: {
+		if (fields_[1].empty())
+			return "course_id is empty";
+		sqlite3_bind_text(stmt, 2, fields_[1].c_str(), -1, SQLITE_TRANSIENT);
+		if (!parse_int(fields_[2], number) || number < -1 || number > 100)
+			return "score must be an integer from 0 to 100, or -1";
+		sqlite3_bind_int(stmt, 3, number);
+
+		sqlite3_bind_int(student_exists, 1, id);
+		bool exists = sqlite3_step(student_exists) == SQLITE_ROW;
+		sqlite3_reset(student_exists);
+		if (!exists)
+			return "student " + to_string(id) + " does not exist";
+		break;
+	}
+	}
+	return "";
+}
+
+void CsvImporter::import_rows(Connection& conn, size_t max_rows) {
+	auto stmt = conn.prepare(insert_sql(kind_));
+	auto student_exists = conn.prepare("SELECT 1 FROM students WHERE id = ?;");
+	if (!stmt || !student_exists)
+		throw runtime_error(sqlite3_errmsg(conn.get()));
+
+	for (size_t n = 0; n < max_rows; n++) {
+		if (!reader_.next(fields_)) {
+			done_ = true;
+			return;
+		}
+		// 空行（比如文件末尾多出来的换行）直接忽略
+		if (fields_.size() == 1 && fields_[0].empty())
+			continue;
+
+		stats_.rows++;
+		string error = bind_row(stmt, student_exists);
+		if (error.empty()) {
+			if (sqlite3_step(stmt) != SQLITE_DONE)
+				throw runtime_error(sqlite3_errmsg(conn.get()));
+			stats_.imported++;
+		} else
+			skip(error);
+
+		sqlite3_reset(stmt);
+		sqlite3_clear_bindings(stmt);
+	}
+}
+
+void drop_import_indexes(Connection& conn, ImportKind kind) {
+	if (kind != ImportKind::Enrollments)
+		return;
+	if (sqlite3_exec(conn.get(), "DROP INDEX IF EXISTS idx_enrollments_course;", nullptr, nullptr, nullptr) != SQLITE_OK)
+		throw runtime_error(sqlite3_errmsg(conn.get()));
+}
+
+void create_import_indexes(Connection& conn, ImportKind kind) {
+	if (kind != ImportKind::Enrollments)
+		return;
+	// 和 migrations.cpp 第3版建的索引相同
+	if (sqlite3_exec(conn.get(), "CREATE INDEX IF NOT EXISTS idx_enrollments_course ON enrollments(course_id, student_id);",
+			nullptr, nullptr, nullptr) != SQLITE_OK)
+		throw runtime_error(sqlite3_errmsg(conn.get()));
+}
+
+string import_summary(const string& kind, const ImportStats& stats, double seconds) {
+	string& out = json_buffer();
+	JsonWriter w(out);
+	w.begin_object();
+	w.key("kind"); w.value(kind);
+	w.key("rows"); w.value(static_cast<int64_t>(stats.rows));
+	w.key("imported"); w.value(static_cast<int64_t>(stats.imported));
+	w.key("skipped"); w.value(static_cast<int64_t>(stats.skipped));
+	w.key("seconds"); w.value(seconds);
+	w.key("rows_per_second"); w.value(seconds > 0 ? stats.rows / seconds : 0.0);
+	w.key("errors");
+	w.begin_array();
+	for (const auto& error : stats.errors)
+		w.value(error);
+	w.end_array();
+	w.end_object();
+	return out;
+}
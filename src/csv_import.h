@@ -0,0 +1,109 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#pragma once
+
+#include "connection.h"
+
+#include <cstddef>
+#include <istream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ CSV批量导入学生、老师和选课成绩。原来只能对着 build/init.sql 手写SQL往 info.db 里填数据。
+
+ 文件第一行是表头，列名和顺序必须和下面一致：
+	students:    id,name,class,password,phone_number,gender,wish
+	teachers:    id,name,course_name,password,course1,course2
+	enrollments: student_id,course_id,score          （score 为 -1 表示还没有成绩）
+ 已存在的id/选课会被更新。每一行都会校验，格式不对、选课的学生不存在的行跳过并记下行号和原因，不影响其他行。
+
+ CsvReader 每次只读一行，不会把整个文件读进内存；CsvImporter 每次导入一段，由调用方决定每段放进哪个事务：
+	命令行模式（informationSystem --import ...）每5万行提交一次，导入选课前先删掉按课程的索引，导完再建；
+	服务器的 /admin/import 每段是写线程里的一个任务，段与段之间其他写请求可以照常执行。
+*/
+
+enum class ImportKind { Students, Teachers, Enrollments };
+
+// "students" / "teachers" / "enrollments"（也可以写 "scores"），不认识时返回 false
+bool parse_import_kind(const std::string& name, ImportKind& kind);
+
+// 逐行读取CSV，支持双引号括起来的字段（里面可以有逗号、换行和 "" 表示的引号）
+class CsvReader {
+public:
+	explicit CsvReader(std::istream& in) : in_(in) {}
+
+	// 读下一行到 fields，文件结束返回 false。fields 里的字符串会被重复使用，不会每行重新分配
+	bool next(std::vector<std::string>& fields);
+
+	// 刚读到的这一行从第几行开始（从1开始数，带引号的字段跨行时行号会跳过去）
+	std::size_t line() const { return record_line_; }
+
+private:
+	std::istream& in_;
+	std::size_t line_ = 1;
+	std::size_t record_line_ = 0;
+	bool first_ = true;
+};
+
+// 直接读一段已经在内存里的文本（比如 /admin/import 的请求体），不像 istringstream 那样先拷贝一份。
+// data 指向的内存要比它活得久
+class MemoryStreamBuf : public std::streambuf {
+public:
+	explicit MemoryStreamBuf(std::string_view data) {
+		char* begin = const_cast<char*>(data.data());
+		setg(begin, begin, begin + data.size());
+	}
+
+	// 已经读了多少字节
+	std::size_t position() const { return static_cast<std::size_t>(gptr() - eback()); }
+};
+
+struct ImportStats {
+	std::size_t rows = 0;     // 读到的数据行
+	std::size_t imported = 0; // 写入数据库的行
+	std::size_t skipped = 0;  // 校验失败跳过的行
+	std::vector<std::string> errors; // 前 kMaxErrors 条错误，"line N: 原因"
+
+	static constexpr std::size_t kMaxErrors = 100;
+};
+
+class CsvImporter {
+public:
+	CsvImporter(ImportKind kind, std::istream& in);
+
+	// 读表头并校验，失败时返回 false 并给出原因
+	bool read_header(std::string& error);
+
+	// 导入接下来最多 max_rows 行，需要在事务里调用；数据库出错时抛出 std::runtime_error
+	void import_rows(Connection& conn, std::size_t max_rows);
+
+	bool done() const { return done_; }
+	ImportKind kind() const { return kind_; }
+	const ImportStats& stats() const { return stats_; }
+
+private:
+	// 校验并绑定一行，失败时返回原因
+	std::string bind_row(sqlite3_stmt* stmt, sqlite3_stmt* student_exists);
+	void skip(const std::string& reason);
+
+	ImportKind kind_;
+	CsvReader reader_;
+	std::vector<std::string> fields_;
+	ImportStats stats_;
+	bool done_ = false;
+};
+
+// 导入结果的JSON（rows/imported/skipped/seconds/rows_per_second/errors），命令行和 /admin/import 共用
+std::string import_summary(const std::string& kind, const ImportStats& stats, double seconds);
+
+// 导入大量选课之前删掉 enrollments 按课程的索引，导完再一次性建好，比逐行维护索引快得多
+void drop_import_indexes(Connection& conn, ImportKind kind);
+void create_import_indexes(Connection& conn, ImportKind kind);
@@ -0,0 +1,84 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#include "db_executor.h"
+#include "async_response.h"
+#include "sql_profiler.h"
+
+#include <chrono>
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+DbExecutor::DbExecutor(const string& path, size_t threads) {
+	if (threads == 0)
+		threads = 1;
+
+	// 先把连接全部打开，失败时还没有线程在运行，异常可以直接抛出去
+	for (size_t i = 0; i < threads; i++)
+		conns_.push_back(make_unique<Connection>(path));
+
+	for (auto& conn : conns_)
+		threads_.emplace_back([this, c = conn.get()] { run(*c); });
+}
+
+DbExecutor::~DbExecutor() {
+	{
+		lock_guard<mutex> lock(mtx_);
+		stopping_ = true;
+	}
+	cv_.notify_all();
+	for (auto& t : threads_)
+		t.join();
+}
+
+void DbExecutor::submit(const crow::request& req, crow::response& res, Job job) {
+	{
+		lock_guard<mutex> lock(mtx_);
+		queue_.push_back([this, &req, &res, job = move(job)](Connection& conn) {
+			auto start = chrono::steady_clock::now();
+			crow::response result;
+			try {
+				result = job(conn);
+			} catch (const exception& e) {
+				cerr << "Read job error: " << e.what() << endl;
+				result = crow::response(500, "Database error");
+			}
+			if (metrics_)
+				metrics_->record_db(req, DbPool::Read, chrono::steady_clock::now() - start);
+			complete_response(req, res, move(result));
+		});
+	}
+	cv_.notify_one();
+}
+
+void DbExecutor::set_profiler(SqlProfiler& profiler) {
+	for (auto& conn : conns_)
+		profiler.attach(*conn);
+}
+
+size_t DbExecutor::queue_length() {
+	lock_guard<mutex> lock(mtx_);
+	return queue_.size();
+}
+
+void DbExecutor::run(Connection& conn) {
+	while (true) {
+		function<void(Connection&)> task;
+		{
+			unique_lock<mutex> lock(mtx_);
+			cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+			if (queue_.empty())
+				return; // stopping_ 且没有剩余任务
+
+			task = move(queue_.front());
+			queue_.pop_front();
+		}
+		task(conn);
+	}
+}
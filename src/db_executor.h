@@ -0,0 +1,76 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#pragma once
+
+#include "crow.h"
+#include "connection.h"
+#include "metrics.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class SqlProfiler;
+
+/*
+ 数据库读线程池：读请求的SQLite调用交给这里的线程执行，每个线程独占一个读连接。
+ 原来handler直接在Crow的io_service线程里查数据库，一条慢查询会卡住这个线程上所有keep-alive连接，
+ 现在io_service线程只负责收发数据，查询在这里排队执行，两边的线程数可以分别调整。
+
+ 写操作仍然交给 DbWriter（单独的写线程）。
+
+ 用法（handler写成异步形式）：
+	CROW_ROUTE(app, "/xxx")([&readers](const crow::request& req, crow::response& res) {
+		... 在这里解析请求 ...
+		readers.submit(req, res, [=](Connection& conn) {
+			... 用 conn 查数据库 ...
+			return crow::response(200, "OK");
+		});
+	});
+*/
+class DbExecutor {
+public:
+	using Job = std::function<crow::response(Connection& conn)>;
+
+	// 打开 threads 个读连接（打不开时抛出 std::runtime_error），并启动同样数量的线程
+	DbExecutor(const std::string& path, std::size_t threads);
+	// 执行完队列中剩余的任务后停止所有线程
+	~DbExecutor();
+
+	DbExecutor(const DbExecutor&) = delete;
+	DbExecutor& operator=(const DbExecutor&) = delete;
+
+	// 提交一个读任务，执行完后异步结束 res
+	void submit(const crow::request& req, crow::response& res, Job job);
+
+	// 正在排队、还没开始执行的任务数
+	std::size_t queue_length();
+
+	// 之后每个任务执行SQL的耗时记到 metrics（按请求的路由），要在提交任务之前调用
+	void set_metrics(Metrics* metrics) { metrics_ = metrics; }
+	// 统计所有读连接上每条SQL的耗时（见 sql_profiler.h），也要在提交任务之前调用
+	void set_profiler(SqlProfiler& profiler);
+
+private:
+	void run(Connection& conn);
+
+	std::vector<std::unique_ptr<Connection>> conns_;
+	std::vector<std::thread> threads_;
+
+	std::deque<std::function<void(Connection&)>> queue_;
+	std::mutex mtx_;
+	std::condition_variable cv_;
+	bool stopping_ = false;
+	Metrics* metrics_ = nullptr;
+};
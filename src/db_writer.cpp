@@ -0,0 +1,149 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#include "db_writer.h"
+#include "async_response.h"
+#include "sql_profiler.h"
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+DbWriter::DbWriter(const string& path, size_t max_batch) : conn_(path), max_batch_(max_batch ? max_batch : 1) {
+	// WAL模式下读不阻塞写、写不阻塞读，这个设置会保存在数据库文件里
+	auto stmt = conn_.prepare("PRAGMA journal_mode=WAL;");
+	if (!stmt || sqlite3_step(stmt) != SQLITE_ROW)
+		throw runtime_error(string("Can't enable WAL mode: ") + sqlite3_errmsg(conn_.get()));
+
+	thread_ = thread([this] { run(); });
+}
+
+DbWriter::~DbWriter() {
+	{
+		lock_guard<mutex> lock(mtx_);
+		stopping_ = true;
+	}
+	cv_.notify_one();
+	thread_.join();
+}
+
+void DbWriter::submit(Job job, Done done) {
+	push({move(job), move(done)});
+}
+
+void DbWriter::submit(const crow::request& req, crow::response& res, Job job) {
+	push({move(job), [&req, &res](crow::response result) {
+		complete_response(req, res, move(result));
+	}, &req});
+}
+
+void DbWriter::push(Task task) {
+	{
+		lock_guard<mutex> lock(mtx_);
+		queue_.push_back(move(task));
+	}
+	cv_.notify_one();
+}
+
+void DbWriter::set_profiler(SqlProfiler& profiler) {
+	profiler.attach(conn_);
+}
+
+size_t DbWriter::queue_length() {
+	lock_guard<mutex> lock(mtx_);
+	return queue_.size();
+}
+
+void DbWriter::after_commit(function<void()> action) {
+	job_actions_.push_back(move(action));
+}
+
+void DbWriter::run() {
+	while (true) {
+		deque<Task> batch;
+		{
+			unique_lock<mutex> lock(mtx_);
+			cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+			if (queue_.empty())
+				return; // stopping_ 且没有剩余任务
+
+			// 执行上一批期间积攒下来的任务，一起放进这一批
+			while (!queue_.empty() && batch.size() < max_batch_) {
+				batch.push_back(move(queue_.front()));
+				queue_.pop_front();
+			}
+		}
+		run_batch(batch);
+	}
+}
+
+void DbWriter::run_batch(deque<Task>& batch) {
+	vector<crow::response> results;
+	results.reserve(batch.size());
+
+	{
+		Transaction txn(conn_);
+		if (!txn.ok()) {
+			cerr << "BEGIN error: " << sqlite3_errmsg(conn_.get()) << endl;
+			for (auto& task : batch)
+				task.done(crow::response(500, "Database error"));
+			return;
+		}
+
+		for (auto& task : batch) {
+			exec("SAVEPOINT job;");
+			job_actions_.clear();
+
+			auto start = chrono::steady_clock::now();
+			crow::response result;
+			try {
+				result = task.job(conn_);
+			} catch (const exception& e) {
+				cerr << "Write job error: " << e.what() << endl;
+				result = crow::response(500, "Database error");
+			}
+			if (metrics_ && task.req)
+				metrics_->record_db(*task.req, DbPool::Write, chrono::steady_clock::now() - start);
+
+			// 失败的任务只撤销它自己的修改
+			if (result.code >= 400)
+				exec("ROLLBACK TO job;");
+			else
+				for (auto& action : job_actions_)
+					batch_actions_.push_back(move(action));
+			exec("RELEASE job;");
+
+			results.push_back(move(result));
+		}
+
+		auto commit_start = chrono::steady_clock::now();
+		bool committed = txn.commit();
+		if (metrics_)
+			metrics_->record_commit(chrono::steady_clock::now() - commit_start);
+		if (!committed) {
+			cerr << "COMMIT error: " << sqlite3_errmsg(conn_.get()) << endl;
+			for (auto& result : results)
+				result = crow::response(500, "Database error");
+			batch_actions_.clear();
+		}
+	}
+
+	for (auto& action : batch_actions_)
+		action();
+	batch_actions_.clear();
+
+	for (size_t i = 0; i < batch.size(); i++)
+		batch[i].done(move(results[i]));
+}
+
+bool DbWriter::exec(const char* sql) {
+	auto stmt = conn_.prepare(sql);
+	return stmt && sqlite3_step(stmt) == SQLITE_DONE;
+}
@@ -0,0 +1,102 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#pragma once
+
+#include "crow.h"
+#include "connection.h"
+#include "metrics.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class SqlProfiler;
+
+/*
+ 写线程：所有修改数据库的操作都交给这一个线程执行，它独占唯一的写连接。
+ 原来各个Crow工作线程直接写 info.db，并发时互相抢写锁，经常返回 SQLITE_BUSY。
+
+ 写线程每次把队列里积攒的任务一起放进一个事务执行（组提交），一批只提交一次。
+ 每个任务外面包一层 SAVEPOINT，任务返回的响应码 >= 400 时只回滚它自己的修改，不影响同一批的其他任务。
+ 整批提交成功后，才把各个任务的响应发回给客户端。
+
+ 用法（handler写成异步形式）：
+	CROW_ROUTE(app, "/xxx")([&writer](const crow::request& req, crow::response& res) {
+		... 在这里解析请求 ...
+		writer.submit(req, res, [=](Connection& conn) {
+			... 用 conn 写数据库 ...
+			return crow::response(200, "OK");
+		});
+	});
+*/
+class DbWriter {
+public:
+	using Job = std::function<crow::response(Connection& conn)>;
+	using Done = std::function<void(crow::response)>;
+
+	// 打开写连接，开启WAL模式（读连接和写连接可以同时工作），并启动写线程
+	explicit DbWriter(const std::string& path, std::size_t max_batch = 256);
+	// 执行完队列中剩余的任务后停止写线程
+	~DbWriter();
+
+	DbWriter(const DbWriter&) = delete;
+	DbWriter& operator=(const DbWriter&) = delete;
+
+	// 提交一个写任务，任务所在的事务提交后调用 done
+	void submit(Job job, Done done);
+
+	// 提交一个写任务，任务所在的事务提交后异步结束 res
+	void submit(const crow::request& req, crow::response& res, Job job);
+
+	/*
+	 只能在写任务里调用：登记一个在本批事务提交成功后执行的动作（比如让缓存失效）。
+	 任务失败被回滚时，它登记的动作也会被丢弃。动作在给客户端返回响应之前执行。
+	 动作也在写线程里执行，可以继续用任务拿到的 conn 读取刚提交的数据（比如刷新内存快照）。
+	*/
+	void after_commit(std::function<void()> action);
+
+	// 正在排队、还没开始执行的任务数
+	std::size_t queue_length();
+
+	// 之后每个请求的写任务耗时（按路由）和每批的提交耗时记到 metrics，要在提交任务之前调用
+	void set_metrics(Metrics* metrics) { metrics_ = metrics; }
+	// 统计写连接上每条SQL的耗时（见 sql_profiler.h），也要在提交任务之前调用
+	void set_profiler(SqlProfiler& profiler);
+
+private:
+	struct Task {
+		Job job;
+		Done done;
+		// 由 submit(req, res, job) 提交时才有，用来按路由记录耗时
+		const crow::request* req = nullptr;
+	};
+
+	void push(Task task);
+	void run();
+	void run_batch(std::deque<Task>& batch);
+	bool exec(const char* sql);
+
+	Connection conn_;
+	std::size_t max_batch_;
+
+	// 当前任务登记的动作、本批已成功任务登记的动作，只在写线程里访问
+	std::vector<std::function<void()>> job_actions_;
+	std::vector<std::function<void()>> batch_actions_;
+
+	std::deque<Task> queue_;
+	std::mutex mtx_;
+	std::condition_variable cv_;
+	bool stopping_ = false;
+	Metrics* metrics_ = nullptr;
+	std::thread thread_;
+};
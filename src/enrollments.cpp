@@ -0,0 +1,41 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#include "enrollments.h"
+
+using namespace std;
+
+bool course_for_option(Connection& conn, int stu_id, const string& option, string& course_id) {
+	int slot;
+	if (option == "score1")
+		slot = 0;
+	else if (option == "score2")
+		slot = 1;
+	else
+		return false;
+
+	auto stmt = conn.prepare("SELECT course_id FROM enrollments WHERE student_id = ? ORDER BY rowid LIMIT 1 OFFSET ?;");
+	if (!stmt)
+		return false;
+
+	sqlite3_bind_int(stmt, 1, stu_id);
+	sqlite3_bind_int(stmt, 2, slot);
+	if (sqlite3_step(stmt) != SQLITE_ROW)
+		return false;
+
+	course_id = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+	return true;
+}
+
+bool resolve_course(Connection& conn, int stu_id, const string& course_id_or_empty,
+	const string& option, string& course_id) {
+	if (course_id_or_empty.size()) {
+		course_id = course_id_or_empty;
+		return true;
+	}
+	return course_for_option(conn, stu_id, option, course_id);
+}
@@ -0,0 +1,25 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#pragma once
+
+#include "connection.h"
+#include <string>
+
+/*
+ 选课表 enrollments(student_id, course_id, score, able_to_revise) 的公用操作。
+
+ 旧的前端用 option = "score1"/"score2" 表示学生的第1/2门课，
+ 这里把它转换成具体的课程号，同一个学生的选课按加入的先后（rowid）排序。
+*/
+
+// 把 option 转换成课程号，option 不是 score1/score2 或者学生没有这门课时返回 false
+bool course_for_option(Connection& conn, int stu_id, const std::string& option, std::string& course_id);
+
+// 请求里优先使用 course_id，没有时再用旧的 option 转换；找不到返回 false
+bool resolve_course(Connection& conn, int stu_id, const std::string& course_id_or_empty,
+	const std::string& option, std::string& course_id);
@@ -0,0 +1,196 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#include "export.h"
+#include "json_writer.h"
+#include "repository.h"
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+
+// 只有四种组合，语句缓存不会无限增长；列见 StudentExportRow、GradeRow
+string export_sql(ExportKind kind, const ExportFilter& filter) {
+	string sql;
+	if (kind == ExportKind::Students) {
+		sql = "SELECT " + columns_sql<StudentExportRow>() + " FROM students WHERE 1";
+		if (filter.course_id)
+			sql += " AND id IN (SELECT student_id FROM enrollments WHERE course_id = :course_id)";
+		if (filter.class_no)
+			sql += " AND class = :class";
+		sql += " ORDER BY id;";
+	} else {
+		// 按 (course_id, student_id) 排序正好走 idx_enrollments_course，不需要额外排序
+		sql = "SELECT " + columns_sql<GradeRow>() + " FROM enrollments e JOIN students s ON s.id = e.student_id WHERE 1";
+		if (filter.course_id)
+			sql += " AND e.course_id = :course_id";
+		if (filter.class_no)
+			sql += " AND s.class = :class";
+		sql += " ORDER BY e.course_id, e.student_id;";
+	}
+	return sql;
+}
+
+// CSV字段里有逗号、引号或换行时用引号括起来，里面的引号写两遍
+void csv_field(const char* str, size_t len, string& out) {
+	bool quote = false;
+	for (size_t i = 0; i < len && !quote; i++)
+		quote = str[i] == ',' || str[i] == '"' || str[i] == '\n' || str[i] == '\r';
+	if (!quote) {
+		out.append(str, len);
+		return;
+	}
+	out += '"';
+	for (size_t i = 0; i < len; i++) {
+		if (str[i] == '"')
+			out += '"';
+		out += str[i];
+	}
+	out += '"';
+}
+
+void csv_value(int value, string& out) { json_int(value, out); }
+
+// NULL 写成空字段
+void csv_value(string_view value, string& out) {
+	if (value.data())
+		csv_field(value.data(), value.size(), out);
+}
+
+template <typename Row>
+void csv_header(string& out) {
+	bool first = true;
+	visit_keys<Row>([&out, &first](string_view key) {
+		if (!first)
+			out += ',';
+		first = false;
+		out += key;
+	});
+	out += '\n';
+}
+
+template <typename Row>
+void csv_row(const Row& row, string& out) {
+	bool first = true;
+	visit_columns(row, [&out, &first](string_view, const auto& value) {
+		if (!first)
+			out += ',';
+		first = false;
+		csv_value(value, out);
+	});
+	out += '\n';
+}
+
+template <typename Row>
+size_t write_rows(sqlite3* db, sqlite3_stmt* stmt, ExportFormat file_format, ofstream& file) {
+	const size_t flush_size = 64 * 1024;
+	string buf;
+	buf.reserve(flush_size + 4096);
+
+	// 带上UTF-8 BOM，Excel打开时中文才不会乱码（csv_import 会跳过它）
+	if (file_format == ExportFormat::Csv) {
+		buf += "\xEF\xBB\xBF";
+		csv_header<Row>(buf);
+	}
+
+	size_t rows = 0;
+	bool done = for_each_row<Row>(stmt, [&](const Row& row) {
+		if (file_format == ExportFormat::Csv)
+			csv_row(row, buf);
+		else {
+			JsonWriter w(buf);
+			write_json_row(w, row);
+			buf += '\n';
+		}
+		rows++;
+
+		if (buf.size() >= flush_size) {
+			file.write(buf.data(), buf.size());
+			buf.clear();
+		}
+	});
+	if (!done)
+		throw runtime_error(sqlite3_errmsg(db));
+
+	file.write(buf.data(), buf.size());
+	return rows;
+}
+
+} // namespace
+
+bool parse_export_kind(const string& name, ExportKind& kind) {
+	if (name == "students")
+		kind = ExportKind::Students;
+	else if (name == "enrollments" || name == "scores")
+		kind = ExportKind::Enrollments;
+	else
+		return false;
+	return true;
+}
+
+bool parse_export_format(const string& name, ExportFormat& format) {
+	if (name == "csv")
+		format = ExportFormat::Csv;
+	else if (name == "ndjson")
+		format = ExportFormat::Ndjson;
+	else
+		return false;
+	return true;
+}
+
+size_t write_export(Connection& conn, ExportKind kind, ExportFormat format, const ExportFilter& filter, const string& path) {
+	auto stmt = conn.prepare(export_sql(kind, filter));
+	if (!stmt)
+		throw runtime_error(sqlite3_errmsg(conn.get()));
+	if (filter.course_id)
+		sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, ":course_id"), filter.course_id->c_str(), -1, SQLITE_TRANSIENT);
+	if (filter.class_no)
+		sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":class"), *filter.class_no);
+
+	ofstream file(path, ios::binary | ios::trunc);
+	if (!file)
+		throw runtime_error("Can't create " + path);
+
+	size_t rows = kind == ExportKind::Students
+		? write_rows<StudentExportRow>(conn.get(), stmt, format, file)
+		: write_rows<GradeRow>(conn.get(), stmt, format, file);
+
+	file.close();
+	if (!file)
+		throw runtime_error("Can't write " + path);
+	return rows;
+}
+
+ExportDirectory::ExportDirectory(string dir, chrono::seconds keep) : dir_(move(dir)), keep_(keep) {
+	error_code ec;
+	fs::remove_all(dir_, ec);
+	fs::create_directories(dir_, ec);
+	if (ec)
+		throw runtime_error("Can't create " + dir_ + ": " + ec.message());
+}
+
+string ExportDirectory::new_file() {
+	remove_expired();
+	auto now = chrono::system_clock::now().time_since_epoch();
+	return dir_ + "/" + to_string(chrono::duration_cast<chrono::milliseconds>(now).count()) + "-" +
+		to_string(next_id_.fetch_add(1, memory_order_relaxed)) + ".txt";
+}
+
+void ExportDirectory::remove_expired() {
+	error_code ec;
+	auto expire = fs::file_time_type::clock::now() - keep_;
+	for (fs::directory_iterator it(dir_, ec), end; !ec && it != end; it.increment(ec)) {
+		error_code file_ec;
+		if (it->last_write_time(file_ec) < expire && !file_ec)
+			fs::remove(it->path(), file_ec);
+	}
+}
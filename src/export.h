@@ -0,0 +1,62 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#pragma once
+
+#include "connection.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+/*
+ 导出学生表和成绩单（CSV或NDJSON），代替从 /get_course 的JSON里抠数据。
+
+ Crow 不支持边生成边发送的响应体（chunked），只有静态文件是分块从磁盘读出来发送的。
+ 所以导出时用SQLite游标一行一行写进临时文件，写满64KB刷一次盘，再把这个文件作为响应发出去，
+ 不管表有多大，内存里始终只有一行数据和一个写缓冲。
+
+	students:    id,name,class,phone_number,gender,wish（不导出密码）
+	enrollments: student_id,name,class,course_id,score，按课程、学号排序
+ 两种都可以按课程（course_id，students 为选了这门课的学生）和班级（class）筛选。
+*/
+
+enum class ExportKind { Students, Enrollments };
+enum class ExportFormat { Csv, Ndjson };
+
+bool parse_export_kind(const std::string& name, ExportKind& kind);
+bool parse_export_format(const std::string& name, ExportFormat& format);
+
+struct ExportFilter {
+	std::optional<std::string> course_id;
+	std::optional<int> class_no;
+};
+
+// 把查询结果写到 path，返回行数；数据库或文件出错时抛出 std::runtime_error
+std::size_t write_export(Connection& conn, ExportKind kind, ExportFormat format, const ExportFilter& filter, const std::string& path);
+
+/*
+ 存放导出临时文件的目录。文件要等Crow发送完才能删除，而发送结束时没有回调，
+ 所以每次生成新文件时顺便删掉放了超过 keep 的旧文件，启动时清空整个目录。
+*/
+class ExportDirectory {
+public:
+	explicit ExportDirectory(std::string dir, std::chrono::seconds keep = std::chrono::minutes(10));
+
+	// 新的临时文件路径。扩展名固定用 .txt，Crow 不认识 csv/ndjson 会打警告日志，Content-Type 由调用方另外设置
+	std::string new_file();
+
+private:
+	void remove_expired();
+
+	std::string dir_;
+	std::chrono::seconds keep_;
+	std::atomic<std::uint64_t> next_id_{0};
+};
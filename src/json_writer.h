@@ -0,0 +1,146 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/*
+ 直接往字符串里写JSON，不经过 crow::json::wvalue。
+ 原来每一行都要先把列拷贝成 std::string，再放进 wvalue（内部是 unique_ptr 组成的map），最后整体 dump，
+ 每行都有好几次堆内存分配。这里把数字直接格式化、把字符串直接转义写进输出缓冲区，
+ 查询结果按 repository.h 里的行类型用 write_json_row 写出，TEXT列不拷贝，
+ 输出缓冲区预留够空间后，写每一行都不再分配内存。
+
+ 逗号由 JsonWriter 自动处理：
+	JsonWriter w(out);
+	w.begin_object();
+	w.key("id"); w.value(1);
+	w.key("name"); w.value("张三");
+	w.end_object();
+*/
+
+// 写JSON字符串的内容（不含两边的引号），需要时转义
+inline void json_escape(const char* str, std::size_t len, std::string& out) {
+	static const char hex[] = "0123456789abcdef";
+	for (std::size_t i = 0; i < len; i++) {
+		char c = str[i];
+		switch (c) {
+		case '"': out += "\\\""; break;
+		case '\\': out += "\\\\"; break;
+		case '\n': out += "\\n"; break;
+		case '\r': out += "\\r"; break;
+		case '\t': out += "\\t"; break;
+		case '\b': out += "\\b"; break;
+		case '\f': out += "\\f"; break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20) {
+				out += "\\u00";
+				out += hex[(c >> 4) & 0xf];
+				out += hex[c & 0xf];
+			} else
+				out += c;
+		}
+	}
+}
+
+// 写整数，不经过 std::to_string 的临时字符串
+inline void json_int(std::int64_t n, std::string& out) {
+	char buf[24];
+	auto result = std::to_chars(buf, buf + sizeof(buf), n);
+	out.append(buf, result.ptr - buf);
+}
+
+class JsonWriter {
+public:
+	explicit JsonWriter(std::string& out) : out_(out) {}
+
+	void begin_object() { open('{'); }
+	void end_object() { close('}'); }
+	void begin_array() { open('['); }
+	void end_array() { close(']'); }
+
+	void key(std::string_view k) {
+		separator();
+		out_ += '"';
+		json_escape(k.data(), k.size(), out_);
+		out_ += "\":";
+		after_key_ = true;
+	}
+
+	void value(std::int64_t n) {
+		separator();
+		json_int(n, out_);
+	}
+	void value(int n) { value(static_cast<std::int64_t>(n)); }
+	void value(double d) {
+		separator();
+		char buf[32];
+		auto result = std::to_chars(buf, buf + sizeof(buf), d);
+		out_.append(buf, result.ptr - buf);
+	}
+	void value(bool b) {
+		separator();
+		out_ += b ? "true" : "false";
+	}
+	void value(std::string_view s) {
+		separator();
+		out_ += '"';
+		json_escape(s.data(), s.size(), out_);
+		out_ += '"';
+	}
+	void value(const char* s) { value(std::string_view(s)); }
+	void null() {
+		separator();
+		out_ += "null";
+	}
+
+private:
+	// 同一层里第一个元素前不加逗号，key后面的值也不加
+	void separator() {
+		if (after_key_) {
+			after_key_ = false;
+			return;
+		}
+		if (depth_ > 0) {
+			if (!first_[depth_ - 1])
+				out_ += ',';
+			first_[depth_ - 1] = false;
+		}
+	}
+
+	void open(char c) {
+		separator();
+		out_ += c;
+		if (depth_ < kMaxDepth)
+			first_[depth_] = true;
+		depth_++;
+	}
+
+	void close(char c) {
+		out_ += c;
+		depth_--;
+	}
+
+	static constexpr int kMaxDepth = 16;
+
+	std::string& out_;
+	bool first_[kMaxDepth] = {};
+	int depth_ = 0;
+	bool after_key_ = false;
+};
+
+// 每个线程一块可以重复使用的输出缓冲区，用完只清空内容，容量保留给下一个请求
+inline std::string& json_buffer() {
+	thread_local std::string buffer;
+	buffer.clear();
+	return buffer;
+}
@@ -0,0 +1,79 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#include "latency.h"
+
+using namespace std;
+
+namespace {
+
+// 0~3微秒各占一个桶，之后每个 [2^e, 2^(e+1)) 分成4个桶
+size_t bucket_of(uint64_t us) {
+	if (us < 4)
+		return us;
+	int e = 63 - __builtin_clzll(us);
+	size_t sub = (us >> (e - 2)) & 3;
+	size_t bucket = (e - 1) * 4 + sub;
+	return bucket < LatencyHistogram::kBuckets ? bucket : LatencyHistogram::kBuckets - 1;
+}
+
+// 桶的上界（不含），单位微秒
+uint64_t bucket_upper(size_t bucket) {
+	if (bucket < 4)
+		return bucket + 1;
+	int e = static_cast<int>(bucket / 4) + 1;
+	return static_cast<uint64_t>(5 + bucket % 4) << (e - 2);
+}
+
+} // namespace
+
+void LatencyHistogram::record(chrono::nanoseconds duration) {
+	auto us = chrono::duration_cast<chrono::microseconds>(duration).count();
+	counts_[bucket_of(us > 0 ? static_cast<uint64_t>(us) : 0)].fetch_add(1, memory_order_relaxed);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+	Snapshot result;
+	for (size_t i = 0; i < kBuckets; i++)
+		result[i] = counts_[i].load(memory_order_relaxed);
+	return result;
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::difference(const Snapshot& later, const Snapshot& earlier) {
+	Snapshot result;
+	for (size_t i = 0; i < kBuckets; i++)
+		result[i] = later[i] - earlier[i];
+	return result;
+}
+
+uint64_t LatencyHistogram::count(const Snapshot& snapshot) {
+	uint64_t n = 0;
+	for (uint64_t c : snapshot)
+		n += c;
+	return n;
+}
+
+double LatencyHistogram::percentile(const Snapshot& snapshot, double q) {
+	uint64_t total = count(snapshot);
+	if (total == 0)
+		return 0;
+
+	// nearest-rank：第 ceil(q * total) 个请求落在哪个桶
+	uint64_t rank = static_cast<uint64_t>(q * total);
+	if (rank < q * total)
+		rank++;
+	if (rank == 0)
+		rank = 1;
+
+	uint64_t seen = 0;
+	for (size_t i = 0; i < kBuckets; i++) {
+		seen += snapshot[i];
+		if (seen >= rank)
+			return bucket_upper(i) / 1000.0;
+	}
+	return bucket_upper(kBuckets - 1) / 1000.0;
+}
@@ -0,0 +1,64 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#pragma once
+
+#include "crow.h"
+#include "metrics.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ 请求耗时的直方图。每个2的幂次再分4个桶（相对误差不超过25%），从1微秒到几天都能放下，
+ 记录一次只是一个 relaxed 的原子加，不加锁。
+ 取两次 snapshot 相减就是这段时间内的分布，比如备份期间的p99。
+*/
+class LatencyHistogram {
+public:
+	static constexpr std::size_t kBuckets = 160;
+	using Snapshot = std::array<std::uint64_t, kBuckets>;
+
+	void record(std::chrono::nanoseconds duration);
+	Snapshot snapshot() const;
+
+	static Snapshot difference(const Snapshot& later, const Snapshot& earlier);
+	static std::uint64_t count(const Snapshot& snapshot);
+	// 第 q（0~1）分位数所在桶的上界，单位毫秒；没有数据时返回0
+	static double percentile(const Snapshot& snapshot, double q);
+
+private:
+	std::array<std::atomic<std::uint64_t>, kBuckets> counts_{};
+};
+
+/*
+ Crow中间件，记录每个请求从开始处理到响应结束的时间。
+ 异步handler的 after_handle 在 res.end() 时才调用，所以交给读写线程的请求也包括了排队和执行数据库的时间。
+ 设置了 metrics 时，同时按路由、方法和状态码记到 /metrics 的直方图里。
+*/
+struct LatencyRecorder {
+	struct context {
+		std::chrono::steady_clock::time_point start;
+	};
+
+	void before_handle(crow::request&, crow::response&, context& ctx) { ctx.start = std::chrono::steady_clock::now(); }
+	void after_handle(crow::request& req, crow::response& res, context& ctx) {
+		// 没有匹配的路由时 Crow 不调用 before_handle，start 还是默认值，这种请求按0计
+		std::chrono::steady_clock::duration elapsed{};
+		if (ctx.start != std::chrono::steady_clock::time_point{})
+			elapsed = std::chrono::steady_clock::now() - ctx.start;
+		histogram.record(elapsed);
+		if (metrics)
+			metrics->record_request(req, res.code, elapsed);
+	}
+
+	LatencyHistogram histogram;
+	Metrics* metrics = nullptr;
+};
@@ -0,0 +1,290 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+// 时间序列的键：种类(4位) | 路由(8位) | 方法或读写(8位) | 状态码(12位)，种类从1开始，所以键不会是0（0表示空槽）
+uint32_t make_key(uint32_t kind, uint32_t route, uint32_t sub, uint32_t status) {
+	return kind << 28 | (route & 0xff) << 20 | (sub & 0xff) << 12 | (status & 0xfff);
+}
+
+uint32_t kind_of(uint32_t key) { return key >> 28; }
+uint32_t route_field(uint32_t key) { return (key >> 20) & 0xff; }
+uint32_t sub_field(uint32_t key) { return (key >> 12) & 0xff; }
+uint32_t status_field(uint32_t key) { return key & 0xfff; }
+
+// 模板里的 <int>、<string> 等匹配URL里的一段
+bool match_route(const string& pattern, const string& url) {
+	size_t p = 0, u = 0;
+	while (p < pattern.size() && u < url.size()) {
+		if (pattern[p] == '<') {
+			size_t close = pattern.find('>', p);
+			size_t slash = url.find('/', u);
+			if (close == string::npos || slash == u)
+				return false;
+			p = close + 1;
+			u = slash == string::npos ? url.size() : slash;
+		} else if (pattern[p++] != url[u++]) {
+			return false;
+		}
+	}
+	return p == pattern.size() && u == url.size();
+}
+
+// Prometheus 标签值里要转义反斜杠、双引号和换行
+void append_label(string& out, const char* name, const string& value) {
+	if (!out.empty())
+		out += ',';
+	out += name;
+	out += "=\"";
+	for (char c : value) {
+		if (c == '\\' || c == '"')
+			out += '\\';
+		if (c == '\n')
+			out += "\\n";
+		else
+			out += c;
+	}
+	out += '"';
+}
+
+void write_histogram(string& out, const char* name, const string& labels, const array<uint64_t, Metrics::kBucketBounds.size() + 1>& buckets, uint64_t sum_us) {
+	string bucket_name = string(name) + "_bucket";
+	uint64_t cumulative = 0;
+	for (size_t i = 0; i < buckets.size(); i++) {
+		cumulative += buckets[i];
+		string le = labels;
+		if (i < Metrics::kBucketBounds.size()) {
+			char bound[32];
+			snprintf(bound, sizeof(bound), "%g", Metrics::kBucketBounds[i] / 1e6);
+			append_label(le, "le", bound);
+		} else {
+			append_label(le, "le", "+Inf");
+		}
+		write_metric(out, bucket_name.c_str(), le, cumulative);
+	}
+	// count 就是 +Inf 桶，不单独计数，抓取时两者不会对不上
+	write_metric(out, (string(name) + "_sum").c_str(), labels, sum_us / 1e6);
+	write_metric(out, (string(name) + "_count").c_str(), labels, cumulative);
+}
+
+atomic<uint64_t> next_metrics_id{1};
+
+} // namespace
+
+Metrics::Metrics() : id_(next_metrics_id.fetch_add(1)) {
+	routes_.push_back("unmatched");
+}
+
+void Metrics::add_route(const string& pattern) {
+	if (routes_.size() > kMaxRoutes || exact_routes_.count(pattern))
+		return;
+	for (uint32_t id : param_routes_)
+		if (routes_[id] == pattern)
+			return;
+
+	uint32_t id = static_cast<uint32_t>(routes_.size());
+	routes_.push_back(pattern);
+	if (pattern.find('<') == string::npos)
+		exact_routes_.emplace(pattern, id);
+	else
+		param_routes_.push_back(id);
+}
+
+uint32_t Metrics::route_of(const string& url) const {
+	auto it = exact_routes_.find(url);
+	if (it != exact_routes_.end())
+		return it->second;
+	for (uint32_t id : param_routes_)
+		if (match_route(routes_[id], url))
+			return id;
+	return 0;
+}
+
+void Metrics::record_request(const crow::request& req, int status, chrono::nanoseconds duration) {
+	record(make_key(Request, route_of(req.url), static_cast<uint32_t>(req.method), static_cast<uint32_t>(status)), duration);
+}
+
+void Metrics::record_db(const crow::request& req, DbPool pool, chrono::nanoseconds duration) {
+	record(make_key(Db, route_of(req.url), static_cast<uint32_t>(pool), 0), duration);
+}
+
+void Metrics::record_commit(chrono::nanoseconds duration) {
+	record(make_key(Commit, 0, 0, 0), duration);
+}
+
+size_t Metrics::slot_of(uint32_t key) {
+	size_t slot = (key * 2654435761u) % kMaxSeries;
+	for (size_t probe = 0; probe < kMaxSeries; probe++, slot = (slot + 1) % kMaxSeries) {
+		uint32_t current = keys_[slot].load(memory_order_acquire);
+		if (current == key)
+			return slot;
+		if (current == 0) {
+			if (keys_[slot].compare_exchange_strong(current, key, memory_order_acq_rel))
+				return slot;
+			// 别的线程抢先占了这个槽，可能正好是同一个键
+			if (current == key)
+				return slot;
+		}
+	}
+	return kMaxSeries;
+}
+
+void Metrics::record(uint32_t key, chrono::nanoseconds duration) {
+	size_t slot = slot_of(key);
+	if (slot == kMaxSeries) {
+		dropped_.fetch_add(1, memory_order_relaxed);
+		return;
+	}
+
+	auto us = chrono::duration_cast<chrono::microseconds>(duration).count();
+	uint64_t value = us > 0 ? static_cast<uint64_t>(us) : 0;
+	size_t bucket = lower_bound(kBucketBounds.begin(), kBucketBounds.end(), value) - kBucketBounds.begin();
+
+	// 分片只有当前线程写，不需要原子加
+	Series& series = local_shard().series[slot];
+	auto& count = series.buckets[bucket];
+	count.store(count.load(memory_order_relaxed) + 1, memory_order_relaxed);
+	series.sum_us.store(series.sum_us.load(memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+Metrics::Shard& Metrics::local_shard() {
+	// 进程里通常只有一个 Metrics，最近一次用到的分片直接缓存，不用查表
+	thread_local uint64_t last_owner = 0;
+	thread_local Shard* last = nullptr;
+	if (last_owner == id_)
+		return *last;
+
+	// 同一个线程轮流记录到几个 Metrics 时，每个对象也只分一个分片。
+	// id 不会重复使用，已经析构的 Metrics 留下的项不会再被匹配到
+	thread_local unordered_map<uint64_t, Shard*> owned;
+	Shard*& shard = owned[id_];
+	if (!shard) {
+		lock_guard<mutex> lock(mtx_);
+		shards_.push_back(make_unique<Shard>());
+		shard = shards_.back().get();
+	}
+	last_owner = id_;
+	last = shard;
+	return *shard;
+}
+
+string Metrics::labels_of(uint32_t key) const {
+	string labels;
+	uint32_t route = route_field(key);
+	switch (kind_of(key)) {
+	case Request:
+		append_label(labels, "route", route < routes_.size() ? routes_[route] : routes_[0]);
+		append_label(labels, "method", crow::method_name(static_cast<crow::HTTPMethod>(sub_field(key))));
+		append_label(labels, "status", to_string(status_field(key)));
+		break;
+	case Db:
+		append_label(labels, "route", route < routes_.size() ? routes_[route] : routes_[0]);
+		append_label(labels, "pool", static_cast<DbPool>(sub_field(key)) == DbPool::Read ? "read" : "write");
+		break;
+	}
+	return labels;
+}
+
+void Metrics::write(string& out) const {
+	vector<Shard*> shards;
+	{
+		lock_guard<mutex> lock(mtx_);
+		for (const auto& shard : shards_)
+			shards.push_back(shard.get());
+	}
+
+	struct Sum {
+		uint32_t kind;
+		string labels;
+		array<uint64_t, kBucketBounds.size() + 1> buckets{};
+		uint64_t sum_us = 0;
+	};
+	vector<Sum> sums;
+	for (size_t slot = 0; slot < kMaxSeries; slot++) {
+		uint32_t key = keys_[slot].load(memory_order_acquire);
+		if (key == 0)
+			continue;
+
+		Sum sum;
+		sum.kind = kind_of(key);
+		sum.labels = labels_of(key);
+		for (Shard* shard : shards) {
+			const Series& series = shard->series[slot];
+			for (size_t i = 0; i < sum.buckets.size(); i++)
+				sum.buckets[i] += series.buckets[i].load(memory_order_relaxed);
+			sum.sum_us += series.sum_us.load(memory_order_relaxed);
+		}
+		sums.push_back(move(sum));
+	}
+	sort(sums.begin(), sums.end(), [](const Sum& a, const Sum& b) {
+		return a.kind != b.kind ? a.kind < b.kind : a.labels < b.labels;
+	});
+
+	static constexpr struct {
+		uint32_t kind;
+		const char* name;
+		const char* help;
+	} families[] = {
+		{Request, "ims_http_request_duration_seconds", "Time from the start of handling to the end of the response, by route template, method and status."},
+		{Db, "ims_db_job_duration_seconds", "Time a request's job spent running SQL on a reader or writer thread."},
+		{Commit, "ims_db_commit_duration_seconds", "Time the writer thread spent committing one group of jobs."},
+	};
+	for (const auto& family : families) {
+		write_metric_header(out, family.name, "histogram", family.help);
+		for (const Sum& sum : sums)
+			if (sum.kind == family.kind)
+				write_histogram(out, family.name, sum.labels, sum.buckets, sum.sum_us);
+	}
+
+	write_metric_header(out, "ims_metrics_dropped_samples_total", "counter", "Samples dropped because all series slots were taken.");
+	write_metric(out, "ims_metrics_dropped_samples_total", "", dropped_.load(memory_order_relaxed));
+}
+
+void write_metric_header(string& out, const char* name, const char* type, const char* help) {
+	out += "# HELP ";
+	out += name;
+	out += ' ';
+	out += help;
+	out += "\n# TYPE ";
+	out += name;
+	out += ' ';
+	out += type;
+	out += '\n';
+}
+
+static void write_sample_name(string& out, const char* name, const string& labels) {
+	out += name;
+	if (!labels.empty()) {
+		out += '{';
+		out += labels;
+		out += '}';
+	}
+	out += ' ';
+}
+
+void write_metric(string& out, const char* name, const string& labels, uint64_t value) {
+	write_sample_name(out, name, labels);
+	out += to_string(value);
+	out += '\n';
+}
+
+void write_metric(string& out, const char* name, const string& labels, double value) {
+	write_sample_name(out, name, labels);
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%.10g", value);
+	out += buf;
+	out += '\n';
+}
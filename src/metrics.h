@@ -0,0 +1,98 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#pragma once
+
+#include "crow.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 数据库任务在哪个线程上执行
+enum class DbPool { Read, Write };
+
+/*
+ /metrics 用的运行指标，按 Prometheus 的文本格式输出。
+ 记录三种直方图：每个请求的耗时（按路由、方法、状态码）、每个请求在读写线程里执行SQL的耗时（按路由和读/写），
+ 以及写线程每批事务提交的耗时。
+
+ 路由按注册时的模板分组（/admin/import/<string> 而不是实际的URL），没注册过的URL都算作 unmatched，
+ 这样随便访问一些不存在的URL也不会让时间序列无限增多。
+
+ 记录的时候不加锁：每个线程第一次记录时分到一个自己的分片，之后只有这个线程写它（relaxed 的读加写，没有原子加），
+ 抓取时把所有分片加起来。时间序列（路由、方法、状态码的组合）在一张全局的开放寻址表里用CAS分配槽位，
+ 最多 kMaxSeries 个，超出的样本丢弃并计数。
+*/
+class Metrics {
+public:
+	static constexpr std::size_t kMaxSeries = 256;
+	static constexpr std::size_t kMaxRoutes = 255;
+	// 直方图各个桶的上界，单位微秒，最后还有一个 +Inf
+	static constexpr std::array<std::uint64_t, 16> kBucketBounds = {
+		100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+		100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000};
+
+	Metrics();
+
+	Metrics(const Metrics&) = delete;
+	Metrics& operator=(const Metrics&) = delete;
+
+	// 登记一个路由模板，要在开始处理请求之前调用（见 routes.cpp 的 ROUTE）
+	void add_route(const std::string& pattern);
+
+	void record_request(const crow::request& req, int status, std::chrono::nanoseconds duration);
+	void record_db(const crow::request& req, DbPool pool, std::chrono::nanoseconds duration);
+	void record_commit(std::chrono::nanoseconds duration);
+
+	// 把所有直方图按文本格式追加到 out
+	void write(std::string& out) const;
+
+private:
+	struct Series {
+		std::array<std::atomic<std::uint64_t>, kBucketBounds.size() + 1> buckets{};
+		std::atomic<std::uint64_t> sum_us{0};
+	};
+
+	struct Shard {
+		std::array<Series, kMaxSeries> series;
+	};
+
+	enum Kind : std::uint32_t { Request = 1, Db = 2, Commit = 3 };
+
+	std::uint32_t route_of(const std::string& url) const;
+	std::size_t slot_of(std::uint32_t key);
+	void record(std::uint32_t key, std::chrono::nanoseconds duration);
+	Shard& local_shard();
+	std::string labels_of(std::uint32_t key) const;
+
+	// 区分不同的 Metrics 对象，线程缓存的分片指针按它匹配
+	const std::uint64_t id_;
+
+	// 下标就是路由编号，0 是 unmatched
+	std::vector<std::string> routes_;
+	std::unordered_map<std::string, std::uint32_t> exact_routes_;
+	std::vector<std::uint32_t> param_routes_;
+
+	std::array<std::atomic<std::uint32_t>, kMaxSeries> keys_{};
+	std::atomic<std::uint64_t> dropped_{0};
+
+	mutable std::mutex mtx_;
+	std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+// Prometheus 文本格式：一个指标的 HELP/TYPE 行，和 name{labels} value 的一行样本
+void write_metric_header(std::string& out, const char* name, const char* type, const char* help);
+void write_metric(std::string& out, const char* name, const std::string& labels, std::uint64_t value);
+void write_metric(std::string& out, const char* name, const std::string& labels, double value);
@@ -0,0 +1,315 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#include "migrations.h"
+#include "crow/logging.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// 版本3的 ALTER TABLE DROP COLUMN 和审核申请用的 DELETE ... RETURNING 都要 SQLite 3.35 以上
+const int kMinSqliteVersion = 3035000;
+const char* kMinSqliteVersionText = "3.35.0";
+
+struct Migration {
+	int version;
+	const char* description;
+	const char* sql;
+	// 升级前执行，每行返回（说明, 行数），统计这一步会丢掉或无法迁移的数据；行数不为0的写进日志。没有时为空
+	const char* dropped = nullptr;
+};
+
+const vector<Migration>& migrations() {
+	static const vector<Migration> list = {
+		{1, "initial schema (build/init.sql)", R"(
+			CREATE TABLE IF NOT EXISTS "teachers" (
+				"id"	INTEGER,
+				"name"	TEXT,
+				"course_name"	TEXT,
+				"password"	INTEGER,
+				"course1"	TEXT,
+				"course2"	TEXT
+			);
+			CREATE TABLE IF NOT EXISTS "students" (
+				"id"	INTEGER,
+				"name"	TEXT,
+				"class"	INTEGER,
+				"password"	INTEGER,
+				"course1"	TEXT,
+				"course2"	TEXT,
+				"score1"	INTEGER,
+				"score2"	INTEGER,
+				"phone_number"	TEXT,
+				"gender"	INTEGER,
+				"wish"	TEXT,
+				"able_to_revise1"	INTEGER,
+				"able_to_revise2"	INTEGER
+			);
+			CREATE TABLE IF NOT EXISTS "requests_teacher" (
+				"req_id"	TEXT,
+				"stu_id"	INTEGER,
+				"option"	TEXT,
+				"new_score"	INTEGER
+			);
+			CREATE TABLE IF NOT EXISTS "requests_student" (
+				"req_id"	TEXT,
+				"id"	INTEGER,
+				"name"	TEXT,
+				"gender"	INTEGER,
+				"phone_number"	TEXT,
+				"wish"	TEXT
+			);
+		)"},
+
+		// SQLite不能用ALTER TABLE加主键，只能建新表、拷数据、再改名。
+		// id/req_id重复的行只保留最后一条，没有id的行无法登录也无法审核，直接丢弃，丢掉的行数写进日志。
+		{2, "primary keys on id/req_id, indexes on students.course1/course2", R"(
+			CREATE TABLE "teachers_new" (
+				"id"	INTEGER PRIMARY KEY,
+				"name"	TEXT,
+				"course_name"	TEXT,
+				"password"	INTEGER,
+				"course1"	TEXT,
+				"course2"	TEXT
+			);
+			INSERT OR REPLACE INTO teachers_new SELECT * FROM teachers WHERE id IS NOT NULL;
+			DROP TABLE teachers;
+			ALTER TABLE teachers_new RENAME TO teachers;
+
+			CREATE TABLE "students_new" (
+				"id"	INTEGER PRIMARY KEY,
+				"name"	TEXT,
+				"class"	INTEGER,
+				"password"	INTEGER,
+				"course1"	TEXT,
+				"course2"	TEXT,
+				"score1"	INTEGER,
+				"score2"	INTEGER,
+				"phone_number"	TEXT,
+				"gender"	INTEGER,
+				"wish"	TEXT,
+				"able_to_revise1"	INTEGER,
+				"able_to_revise2"	INTEGER
+			);
+			INSERT OR REPLACE INTO students_new SELECT * FROM students WHERE id IS NOT NULL;
+			DROP TABLE students;
+			ALTER TABLE students_new RENAME TO students;
+			CREATE INDEX idx_students_course1 ON students(course1);
+			CREATE INDEX idx_students_course2 ON students(course2);
+
+			CREATE TABLE "requests_teacher_new" (
+				"req_id"	TEXT NOT NULL PRIMARY KEY,
+				"stu_id"	INTEGER,
+				"option"	TEXT,
+				"new_score"	INTEGER
+			);
+			INSERT OR REPLACE INTO requests_teacher_new SELECT * FROM requests_teacher WHERE req_id IS NOT NULL;
+			DROP TABLE requests_teacher;
+			ALTER TABLE requests_teacher_new RENAME TO requests_teacher;
+
+			CREATE TABLE "requests_student_new" (
+				"req_id"	TEXT NOT NULL PRIMARY KEY,
+				"id"	INTEGER,
+				"name"	TEXT,
+				"gender"	INTEGER,
+				"phone_number"	TEXT,
+				"wish"	TEXT
+			);
+			INSERT OR REPLACE INTO requests_student_new SELECT * FROM requests_student WHERE req_id IS NOT NULL;
+			DROP TABLE requests_student;
+			ALTER TABLE requests_student_new RENAME TO requests_student;
+		)", R"(
+			SELECT 'teachers rows dropped for a missing or duplicate id', count(*) - count(DISTINCT id) FROM teachers
+			UNION ALL SELECT 'students rows dropped for a missing or duplicate id', count(*) - count(DISTINCT id) FROM students
+			UNION ALL SELECT 'requests_teacher rows dropped for a missing or duplicate req_id', count(*) - count(DISTINCT req_id) FROM requests_teacher
+			UNION ALL SELECT 'requests_student rows dropped for a missing or duplicate req_id', count(*) - count(DISTINCT req_id) FROM requests_student;
+		)"},
+
+		// 选课关系从 students 的 course1/course2、score1/score2、able_to_revise1/able_to_revise2 六列
+		// 拆到单独的 enrollments 表，一个学生可以选任意多门课，按课程查名单走 (course_id, student_id) 索引。
+		// 旧接口里的 score1/score2 表示学生的第1/2门课，迁移时先插入所有第1门课再插入第2门课，
+		// 所以同一个学生的选课按 rowid 排序就是原来的顺序。
+		// 修改成绩的申请原来只记录 score1/score2，现在同时记录是哪门课。
+		// course1 和 course2 相同时第2门课的成绩会丢掉，找不到课程的申请 course_id 为空，这两种的行数都写进日志。
+		{3, "enrollments table replaces students.course1/course2/score1/score2/able_to_revise1/able_to_revise2", R"(
+			CREATE TABLE "enrollments" (
+				"student_id"	INTEGER NOT NULL,
+				"course_id"	TEXT NOT NULL,
+				"score"	INTEGER NOT NULL DEFAULT -1,
+				"able_to_revise"	INTEGER NOT NULL DEFAULT 1,
+				PRIMARY KEY ("student_id", "course_id")
+			);
+			CREATE INDEX idx_enrollments_course ON enrollments(course_id, student_id);
+
+			INSERT OR IGNORE INTO enrollments (student_id, course_id, score, able_to_revise)
+				SELECT id, course1, IFNULL(score1, -1), IFNULL(able_to_revise1, 1) FROM students
+				WHERE course1 IS NOT NULL AND course1 != '';
+			INSERT OR IGNORE INTO enrollments (student_id, course_id, score, able_to_revise)
+				SELECT id, course2, IFNULL(score2, -1), IFNULL(able_to_revise2, 1) FROM students
+				WHERE course2 IS NOT NULL AND course2 != '';
+
+			ALTER TABLE requests_teacher ADD COLUMN "course_id" TEXT;
+			UPDATE requests_teacher SET course_id = (
+				SELECT CASE requests_teacher.option WHEN 'score1' THEN course1 WHEN 'score2' THEN course2 END
+				FROM students WHERE students.id = requests_teacher.stu_id
+			);
+
+			DROP INDEX idx_students_course1;
+			DROP INDEX idx_students_course2;
+			ALTER TABLE students DROP COLUMN course1;
+			ALTER TABLE students DROP COLUMN course2;
+			ALTER TABLE students DROP COLUMN score1;
+			ALTER TABLE students DROP COLUMN score2;
+			ALTER TABLE students DROP COLUMN able_to_revise1;
+			ALTER TABLE students DROP COLUMN able_to_revise2;
+		)", R"(
+			SELECT 'score2 values dropped because course2 repeats course1', count(*) FROM students
+				WHERE course1 IS NOT NULL AND course1 != '' AND course1 = course2
+			UNION ALL SELECT 'requests_teacher rows left without a course_id (unknown student or option)', count(*)
+				FROM requests_teacher r LEFT JOIN students s ON s.id = r.stu_id
+				WHERE CASE r.option WHEN 'score1' THEN s.course1 WHEN 'score2' THEN s.course2 END IS NULL;
+		)"},
+
+		// 每门课的成绩汇总（选课人数、有成绩的人数、总分、平方和）和分数段人数，由 enrollments 上的触发器维护，
+		// 录入成绩、审核改分、直接运行 reset.sql 都在同一个事务里更新汇总。-1（还没有成绩）只计入选课人数，
+		// 分数段 bucket 是 分数/10，90分以上都算第9段。人数变成0的行会被删掉，和重新统计的结果保持一致。
+		{4, "course_aggregates/course_histogram maintained by triggers on enrollments", R"(
+			CREATE TABLE "course_aggregates" (
+				"course_id"	TEXT NOT NULL PRIMARY KEY,
+				"enrolled"	INTEGER NOT NULL,
+				"graded"	INTEGER NOT NULL,
+				"sum"	INTEGER NOT NULL,
+				"sum_sq"	INTEGER NOT NULL
+			);
+			CREATE TABLE "course_histogram" (
+				"course_id"	TEXT NOT NULL,
+				"bucket"	INTEGER NOT NULL,
+				"count"	INTEGER NOT NULL,
+				PRIMARY KEY ("course_id", "bucket")
+			) WITHOUT ROWID;
+
+			INSERT INTO course_aggregates
+				SELECT course_id, COUNT(*), SUM(score >= 0), SUM((score >= 0) * score), SUM((score >= 0) * score * score)
+				FROM enrollments GROUP BY course_id;
+			INSERT INTO course_histogram
+				SELECT course_id, MIN(score / 10, 9), COUNT(*) FROM enrollments WHERE score >= 0
+				GROUP BY course_id, MIN(score / 10, 9);
+
+			CREATE TRIGGER enrollments_aggregate_insert AFTER INSERT ON enrollments BEGIN
+				INSERT INTO course_aggregates
+					VALUES (NEW.course_id, 1, NEW.score >= 0, (NEW.score >= 0) * NEW.score, (NEW.score >= 0) * NEW.score * NEW.score)
+					ON CONFLICT (course_id) DO UPDATE SET enrolled = enrolled + 1, graded = graded + excluded.graded,
+						sum = sum + excluded.sum, sum_sq = sum_sq + excluded.sum_sq;
+				INSERT INTO course_histogram SELECT NEW.course_id, MIN(NEW.score / 10, 9), 1 WHERE NEW.score >= 0
+					ON CONFLICT (course_id, bucket) DO UPDATE SET count = count + 1;
+			END;
+
+			CREATE TRIGGER enrollments_aggregate_delete AFTER DELETE ON enrollments BEGIN
+				UPDATE course_aggregates SET enrolled = enrolled - 1, graded = graded - (OLD.score >= 0),
+					sum = sum - (OLD.score >= 0) * OLD.score, sum_sq = sum_sq - (OLD.score >= 0) * OLD.score * OLD.score
+					WHERE course_id = OLD.course_id;
+				DELETE FROM course_aggregates WHERE course_id = OLD.course_id AND enrolled = 0;
+				UPDATE course_histogram SET count = count - 1
+					WHERE OLD.score >= 0 AND course_id = OLD.course_id AND bucket = MIN(OLD.score / 10, 9);
+				DELETE FROM course_histogram WHERE course_id = OLD.course_id AND count = 0;
+			END;
+
+			CREATE TRIGGER enrollments_aggregate_update AFTER UPDATE OF score, course_id ON enrollments BEGIN
+				UPDATE course_aggregates SET enrolled = enrolled - 1, graded = graded - (OLD.score >= 0),
+					sum = sum - (OLD.score >= 0) * OLD.score, sum_sq = sum_sq - (OLD.score >= 0) * OLD.score * OLD.score
+					WHERE course_id = OLD.course_id;
+				DELETE FROM course_aggregates WHERE course_id = OLD.course_id AND enrolled = 0;
+				UPDATE course_histogram SET count = count - 1
+					WHERE OLD.score >= 0 AND course_id = OLD.course_id AND bucket = MIN(OLD.score / 10, 9);
+				DELETE FROM course_histogram WHERE course_id = OLD.course_id AND count = 0;
+
+				INSERT INTO course_aggregates
+					VALUES (NEW.course_id, 1, NEW.score >= 0, (NEW.score >= 0) * NEW.score, (NEW.score >= 0) * NEW.score * NEW.score)
+					ON CONFLICT (course_id) DO UPDATE SET enrolled = enrolled + 1, graded = graded + excluded.graded,
+						sum = sum + excluded.sum, sum_sq = sum_sq + excluded.sum_sq;
+				INSERT INTO course_histogram SELECT NEW.course_id, MIN(NEW.score / 10, 9), 1 WHERE NEW.score >= 0
+					ON CONFLICT (course_id, bucket) DO UPDATE SET count = count + 1;
+			END;
+		)"},
+	};
+	return list;
+}
+
+void exec(Connection& conn, const string& sql) {
+	char* err = nullptr;
+	if (sqlite3_exec(conn.get(), sql.c_str(), nullptr, nullptr, &err) != SQLITE_OK) {
+		string msg = err ? err : sqlite3_errmsg(conn.get());
+		sqlite3_free(err);
+		throw runtime_error(msg);
+	}
+}
+
+// 把这一步会丢掉的数据写进日志，不让升级悄悄丢数据
+void log_dropped(Connection& conn, const Migration& m) {
+	if (!m.dropped)
+		return;
+	auto stmt = conn.prepare(m.dropped);
+	if (!stmt)
+		throw runtime_error(sqlite3_errmsg(conn.get()));
+	while (sqlite3_step(stmt) == SQLITE_ROW) {
+		int rows = sqlite3_column_int(stmt, 1);
+		if (rows)
+			CROW_LOG_WARNING << "Migration " << m.version << ": " << rows << " "
+				<< reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+	}
+}
+
+} // namespace
+
+int latest_schema_version() {
+	return migrations().back().version;
+}
+
+int schema_version(Connection& conn) {
+	auto stmt = conn.prepare("PRAGMA user_version;");
+	if (!stmt || sqlite3_step(stmt) != SQLITE_ROW)
+		throw runtime_error(string("Can't read schema version: ") + sqlite3_errmsg(conn.get()));
+	return sqlite3_column_int(stmt, 0);
+}
+
+void run_migrations(Connection& conn) {
+	// 编译时的头文件可能和运行时加载的库不是一个版本，以运行时为准
+	if (sqlite3_libversion_number() < kMinSqliteVersion)
+		throw runtime_error(string("SQLite ") + sqlite3_libversion() + " is too old, this server needs SQLite " +
+			kMinSqliteVersionText + " or newer");
+
+	int current = schema_version(conn);
+	if (current > latest_schema_version())
+		throw runtime_error("Database schema version " + to_string(current) + " is newer than this server");
+
+	for (const auto& m : migrations()) {
+		if (m.version <= current)
+			continue;
+
+		CROW_LOG_INFO << "Upgrading database to version " << m.version << ": " << m.description;
+		Transaction txn(conn);
+		if (!txn.ok())
+			throw runtime_error(string("Can't begin migration: ") + sqlite3_errmsg(conn.get()));
+
+		try {
+			log_dropped(conn, m);
+			exec(conn, m.sql);
+			exec(conn, "PRAGMA user_version = " + to_string(m.version) + ";");
+		} catch (const exception& e) {
+			throw runtime_error("Migration " + to_string(m.version) + " failed: " + e.what());
+		}
+
+		if (!txn.commit())
+			throw runtime_error("Can't commit migration " + to_string(m.version) + ": " + sqlite3_errmsg(conn.get()));
+		current = m.version;
+	}
+}
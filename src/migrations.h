@@ -0,0 +1,28 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#pragma once
+
+#include "connection.h"
+
+/*
+ 数据库结构的版本升级。
+ 当前版本号保存在数据库文件的 PRAGMA user_version 里，服务器启动时把数据库从当前版本依次升级到最新版本，
+ 每一步升级和版本号的修改在同一个事务里完成，中途失败不会留下半升级的数据库。
+ 新建的空数据库也会从版本0开始升级，所以不需要再手动运行 build/init.sql。
+
+ 修改表结构时在 migrations.cpp 的列表末尾追加一项，不要修改已经发布的升级步骤。
+*/
+
+// 最新的数据库版本号
+int latest_schema_version();
+
+// 读取数据库当前的版本号
+int schema_version(Connection& conn);
+
+// 升级到最新版本，失败时抛出 std::runtime_error；运行时的SQLite低于3.35时也直接抛出，不尝试升级
+void run_migrations(Connection& conn);
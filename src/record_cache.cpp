@@ -0,0 +1,215 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#include "record_cache.h"
+#include "repository.h"
+
+#include <mutex>
+
+using namespace std;
+
+namespace {
+
+shared_ptr<StudentRecord> to_record(const StudentRow& row) {
+	auto record = make_shared<StudentRecord>();
+	record->id = row.id;
+	record->name = row.name;
+	record->class_no = row.class_no;
+	record->password = row.password;
+	record->phone_number = row.phone_number;
+	record->gender = row.gender;
+	record->wish = row.wish;
+	return record;
+}
+
+shared_ptr<TeacherRecord> to_record(const TeacherRow& row) {
+	auto record = make_shared<TeacherRecord>();
+	record->id = row.id;
+	record->name = row.name;
+	record->course_name = row.course_name;
+	record->password = row.password;
+	record->course1 = row.course1;
+	record->course2 = row.course2;
+	return record;
+}
+
+} // namespace
+
+shared_ptr<const StudentRecord> load_student(Connection& conn, int id) {
+	// 列由 StudentRow::columns() 生成，解码时按同样的顺序读（见 repository.h）
+	static const string sql = "SELECT " + columns_sql<StudentRow>() + " FROM students WHERE id = ?;";
+	auto stmt = conn.prepare(sql);
+	if (!stmt)
+		return nullptr;
+
+	// 将sql语句中的占位符(?)链接到变量
+	sqlite3_bind_int(stmt, 1, id);
+	if (sqlite3_step(stmt) != SQLITE_ROW)
+		return nullptr;
+
+	StudentRow row;
+	decode(stmt, row);
+	auto record = to_record(row);
+
+	// 选课和成绩，按选课的先后排序
+	static const string course_sql = "SELECT " + columns_sql<EnrollmentRow>() + " FROM enrollments WHERE student_id = ? ORDER BY rowid;";
+	auto course_stmt = conn.prepare(course_sql);
+	if (!course_stmt)
+		return nullptr;
+
+	sqlite3_bind_int(course_stmt, 1, id);
+	for_each_row<EnrollmentRow>(course_stmt, [&record](const EnrollmentRow& e) {
+		record->courses.push_back({string(e.course_id), e.score});
+	});
+
+	return record;
+}
+
+shared_ptr<const TeacherRecord> load_teacher(Connection& conn, int id) {
+	static const string sql = "SELECT " + columns_sql<TeacherRow>() + " FROM teachers WHERE id = ?;";
+	auto stmt = conn.prepare(sql);
+	if (!stmt)
+		return nullptr;
+
+	sqlite3_bind_int(stmt, 1, id);
+	if (sqlite3_step(stmt) != SQLITE_ROW)
+		return nullptr;
+
+	TeacherRow row;
+	decode(stmt, row);
+	return to_record(row);
+}
+
+bool RecordCache::load_all(Connection& conn) {
+	array<Map<StudentRecord>, kShards> student_maps;
+	array<Map<TeacherRecord>, kShards> teacher_maps;
+
+	static const string sql = "SELECT " + columns_sql<StudentRow>() + " FROM students;";
+	auto stmt = conn.prepare(sql);
+	if (!stmt)
+		return false;
+
+	// 先建好全部学生，选课加在后面，所以这里还是可修改的 StudentRecord
+	unordered_map<int, shared_ptr<StudentRecord>> students;
+	for_each_row<StudentRow>(stmt, [&students](const StudentRow& row) {
+		students[row.id] = to_record(row);
+	});
+
+	// 和 load_student 一样，每个学生的选课按加入的先后（rowid）排序
+	static const string course_sql = "SELECT " + columns_sql<EnrollmentRow>() + " FROM enrollments ORDER BY rowid;";
+	auto course_stmt = conn.prepare(course_sql);
+	if (!course_stmt)
+		return false;
+	for_each_row<EnrollmentRow>(course_stmt, [&students](const EnrollmentRow& e) {
+		auto it = students.find(e.student_id);
+		if (it != students.end())
+			it->second->courses.push_back({string(e.course_id), e.score});
+	});
+
+	for (auto& [id, record] : students)
+		student_maps[shard_of(id)][id] = move(record);
+
+	static const string teacher_sql = "SELECT " + columns_sql<TeacherRow>() + " FROM teachers;";
+	auto teacher_stmt = conn.prepare(teacher_sql);
+	if (!teacher_stmt)
+		return false;
+	for_each_row<TeacherRow>(teacher_stmt, [&teacher_maps](const TeacherRow& row) {
+		auto record = to_record(row);
+		teacher_maps[shard_of(record->id)][record->id] = move(record);
+	});
+
+	publish_all(students_, student_maps);
+	publish_all(teachers_, teacher_maps);
+	return true;
+}
+
+template <typename Record>
+shared_ptr<const Record> RecordCache::get(Shards<Record>& shards, int id) {
+	// 查的是某一时刻完整的分片，查找期间即使被替换，这份map也不会被释放
+	auto record = shards[shard_of(id)].records.read([id](const Map<Record>& records) -> shared_ptr<const Record> {
+		auto it = records.find(id);
+		return it == records.end() ? nullptr : it->second;
+	});
+
+	(record ? hits_ : misses_).fetch_add(1, memory_order_relaxed);
+	return record;
+}
+
+template <typename Record>
+RecordCache::Generation RecordCache::generation(Shards<Record>& shards, int id) {
+	return shards[shard_of(id)].generation.load(memory_order_acquire);
+}
+
+template <typename Record>
+void RecordCache::put(Shards<Record>& shards, shared_ptr<const Record> record, Generation gen) {
+	auto& shard = shards[shard_of(record->id)];
+	lock_guard<mutex> lock(shard.write_mtx);
+
+	// 读数据库期间这个分片被修改过，读到的可能是旧数据
+	if (shard.generation.load(memory_order_relaxed) != gen)
+		return;
+
+	auto records = make_unique<Map<Record>>(shard.records.current());
+	(*records)[record->id] = move(record);
+	shard.records.store(move(records));
+}
+
+// record 为空时删除
+template <typename Record>
+void RecordCache::replace(Shards<Record>& shards, int id, shared_ptr<const Record> record) {
+	auto& shard = shards[shard_of(id)];
+	lock_guard<mutex> lock(shard.write_mtx);
+	shard.generation.fetch_add(1, memory_order_release);
+
+	auto records = make_unique<Map<Record>>(shard.records.current());
+	if (record)
+		(*records)[id] = move(record);
+	else
+		records->erase(id);
+	shard.records.store(move(records));
+}
+
+template <typename Record>
+void RecordCache::publish_all(Shards<Record>& shards, array<Map<Record>, kShards>& maps) {
+	for (size_t i = 0; i < kShards; i++) {
+		lock_guard<mutex> lock(shards[i].write_mtx);
+		shards[i].generation.fetch_add(1, memory_order_release);
+		shards[i].records.store(make_unique<Map<Record>>(move(maps[i])));
+	}
+}
+
+shared_ptr<const StudentRecord> RecordCache::get_student(int id) { return get(students_, id); }
+shared_ptr<const TeacherRecord> RecordCache::get_teacher(int id) { return get(teachers_, id); }
+
+RecordCache::Generation RecordCache::student_generation(int id) { return generation(students_, id); }
+RecordCache::Generation RecordCache::teacher_generation(int id) { return generation(teachers_, id); }
+
+void RecordCache::put_student(shared_ptr<const StudentRecord> record, Generation gen) { put(students_, move(record), gen); }
+void RecordCache::put_teacher(shared_ptr<const TeacherRecord> record, Generation gen) { put(teachers_, move(record), gen); }
+
+void RecordCache::refresh_student(Connection& conn, int id) { replace(students_, id, load_student(conn, id)); }
+void RecordCache::refresh_teacher(Connection& conn, int id) { replace(teachers_, id, load_teacher(conn, id)); }
+
+void RecordCache::invalidate_student(int id) { replace<StudentRecord>(students_, id, nullptr); }
+void RecordCache::invalidate_teacher(int id) { replace<TeacherRecord>(teachers_, id, nullptr); }
+
+void RecordCache::clear() {
+	array<Map<StudentRecord>, kShards> no_students;
+	array<Map<TeacherRecord>, kShards> no_teachers;
+	publish_all(students_, no_students);
+	publish_all(teachers_, no_teachers);
+}
+
+size_t RecordCache::size() {
+	size_t n = 0;
+	auto count = [](const auto& records) { return records.size(); };
+	for (auto& shard : students_)
+		n += shard.records.read(count);
+	for (auto& shard : teachers_)
+		n += shard.records.read(count);
+	return n;
+}
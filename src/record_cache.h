@@ -0,0 +1,131 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#pragma once
+
+#include "connection.h"
+#include "snapshot_ptr.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 学生的一门课
+struct CourseScore {
+	std::string course_id;
+	int score;
+};
+
+// 解码后的学生记录（students表的一行加上他的全部选课）
+struct StudentRecord {
+	int id;
+	std::string name;
+	int class_no;
+	int password;
+	std::string phone_number;
+	int gender;
+	std::string wish;
+	std::vector<CourseScore> courses;
+};
+
+// 解码后的老师记录
+struct TeacherRecord {
+	int id;
+	std::string name;
+	std::string course_name;
+	int password;
+	std::string course1;
+	std::string course2;
+};
+
+// 从数据库读取一条记录，不存在或出错时返回 nullptr
+std::shared_ptr<const StudentRecord> load_student(Connection& conn, int id);
+std::shared_ptr<const TeacherRecord> load_teacher(Connection& conn, int id);
+
+/*
+ 学生和老师记录的内存快照，key是(用户类型, id)。
+ 启动时用 load_all() 把两张表全部读进内存，登录时几乎所有 /login 都可以直接从内存回答，不用查SQLite。
+
+ 记录按id分成多个分片，每个分片是一张不可修改的map，用 SnapshotPtr 发布（RCU，见 snapshot_ptr.h）：
+ 读的时候在当前的map里直接查找，不加任何锁，不会和写线程或其他读者互相等待；
+ 修改时复制一份分片、改好后替换，旧的map在没有读者再用它之后释放。
+ 修改只发生在写线程提交之后和偶尔的未命中加载，分片分得足够细，每次复制的代价很小。
+
+ 修改数据的写任务提交后调用 refresh_*，从数据库重新读取这条记录放进快照。
+ 快照里没有的id（比如在服务器外面直接改了数据库）仍然从数据库加载后用 put_* 放进来。
+ 为了避免"读线程读到旧数据 -> 写线程提交并刷新 -> 读线程把旧数据放回快照"，
+ 读之前先用 generation() 记下版本号，put 时版本号变了就放弃写入。
+*/
+class RecordCache {
+public:
+	using Generation = std::uint64_t;
+
+	// 从数据库读取全部学生和老师，替换整个快照
+	bool load_all(Connection& conn);
+
+	std::shared_ptr<const StudentRecord> get_student(int id);
+	std::shared_ptr<const TeacherRecord> get_teacher(int id);
+
+	Generation student_generation(int id);
+	Generation teacher_generation(int id);
+
+	void put_student(std::shared_ptr<const StudentRecord> record, Generation gen);
+	void put_teacher(std::shared_ptr<const TeacherRecord> record, Generation gen);
+
+	// 从 conn 重新读取这条记录替换快照里的旧记录，数据库里已经没有时从快照里删除
+	void refresh_student(Connection& conn, int id);
+	void refresh_teacher(Connection& conn, int id);
+
+	void invalidate_student(int id);
+	void invalidate_teacher(int id);
+	// 批量导入等大量修改后直接清空
+	void clear();
+
+	std::uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+	std::uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+	std::size_t size();
+
+private:
+	static constexpr std::size_t kShards = 256;
+
+	template <typename Record>
+	using Map = std::unordered_map<int, std::shared_ptr<const Record>>;
+
+	template <typename Record>
+	struct Shard {
+		SnapshotPtr<Map<Record>> records;
+		std::atomic<Generation> generation{0};
+		std::mutex write_mtx; // 只在修改时使用，读不需要
+	};
+
+	template <typename Record>
+	using Shards = std::array<Shard<Record>, kShards>;
+
+	template <typename Record>
+	std::shared_ptr<const Record> get(Shards<Record>& shards, int id);
+	template <typename Record>
+	Generation generation(Shards<Record>& shards, int id);
+	template <typename Record>
+	void put(Shards<Record>& shards, std::shared_ptr<const Record> record, Generation gen);
+	template <typename Record>
+	void replace(Shards<Record>& shards, int id, std::shared_ptr<const Record> record);
+	template <typename Record>
+	void publish_all(Shards<Record>& shards, std::array<Map<Record>, kShards>& maps);
+
+	static std::size_t shard_of(int id) { return static_cast<std::size_t>(id) % kShards; }
+
+	Shards<StudentRecord> students_;
+	Shards<TeacherRecord> teachers_;
+
+	std::atomic<std::uint64_t> hits_{0};
+	std::atomic<std::uint64_t> misses_{0};
+};
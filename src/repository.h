@@ -0,0 +1,286 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#pragma once
+
+#include "json_writer.h"
+
+#include <sqlite3.h>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <tuple>
+
+/*
+ 带类型的查询结果。每种行是一个结构体，columns() 在编译期列出SQL里的列和对应的成员：
+	struct XxxRow {
+		int id;
+		std::string_view name;
+		static constexpr auto columns() {
+			return std::make_tuple(column("id", &XxxRow::id), column("name", &XxxRow::name));
+		}
+	};
+ SELECT 的列用 columns_sql<XxxRow>() 生成，decode() 按同样的顺序读，列号不用手写，
+ 以后加列、调整顺序只改 columns() 一处，也不会再因为 SELECT * 多读不需要的列。
+
+ TEXT 列解码成指向SQLite内部内存的 std::string_view，不拷贝成 std::string；
+ 它只在下一次 sqlite3_step / reset 之前有效，需要留下来时调用方自己拷贝。NULL 解码成 data() 为空的 string_view。
+*/
+
+// JSON 里的 key：有 AS 时用列的别名，否则是列名去掉表的别名
+constexpr std::string_view json_key(std::string_view sql) {
+	auto as = sql.rfind(" AS ");
+	if (as != std::string_view::npos)
+		return sql.substr(as + 4);
+	auto dot = sql.rfind('.');
+	return dot == std::string_view::npos ? sql : sql.substr(dot + 1);
+}
+
+template <typename Row, typename T>
+struct Column {
+	const char* sql; // SELECT 里的写法，可以带表的别名和列的别名，比如 "s.name"、"e.able_to_revise AS able"
+	std::string_view key;
+	T Row::* member;
+};
+
+// 下面用 columns() 的地方都存成 static constexpr，key 在编译期算好，每一行不用再找别名
+template <typename Row, typename T>
+constexpr Column<Row, T> column(const char* sql, T Row::* member) {
+	return {sql, json_key(sql), member};
+}
+
+inline void read_column(sqlite3_stmt* stmt, int col, int& out) { out = sqlite3_column_int(stmt, col); }
+inline void read_column(sqlite3_stmt* stmt, int col, std::int64_t& out) { out = sqlite3_column_int64(stmt, col); }
+inline void read_column(sqlite3_stmt* stmt, int col, bool& out) { out = sqlite3_column_int(stmt, col) != 0; }
+
+inline void read_column(sqlite3_stmt* stmt, int col, std::string_view& out) {
+	// 先取 text 再取 bytes，顺序反过来时长度可能是转换之前的
+	const unsigned char* text = sqlite3_column_text(stmt, col);
+	out = text ? std::string_view(reinterpret_cast<const char*>(text), sqlite3_column_bytes(stmt, col)) : std::string_view();
+}
+
+// "a, b, c"，拼进 SELECT 或 RETURNING；结果可以存进函数里的 static，只生成一次
+template <typename Row>
+std::string columns_sql() {
+	std::string sql;
+	std::apply([&sql](const auto&... cols) {
+		((sql += sql.empty() ? "" : ", ", sql += cols.sql), ...);
+	}, Row::columns());
+	return sql;
+}
+
+// 把当前行按 columns() 的顺序读进 row
+template <typename Row>
+void decode(sqlite3_stmt* stmt, Row& row) {
+	static constexpr auto columns = Row::columns();
+	std::apply([stmt, &row](const auto&... cols) {
+		int col = 0;
+		(read_column(stmt, col++, row.*(cols.member)), ...);
+	}, columns);
+}
+
+// 执行语句，每一行解码后交给 f，返回是否正常结束（SQLITE_DONE）。row 里的 string_view 只在 f 里有效
+template <typename Row, typename F>
+bool for_each_row(sqlite3_stmt* stmt, F&& f) {
+	Row row;
+	int rc;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		decode(stmt, row);
+		f(static_cast<const Row&>(row));
+	}
+	return rc == SQLITE_DONE;
+}
+
+inline void write_json_value(JsonWriter& w, int value) { w.value(value); }
+inline void write_json_value(JsonWriter& w, std::int64_t value) { w.value(value); }
+inline void write_json_value(JsonWriter& w, bool value) { w.value(value); }
+
+inline void write_json_value(JsonWriter& w, std::string_view value) {
+	if (value.data())
+		w.value(value);
+	else
+		w.null();
+}
+
+// 按 columns() 的顺序对每一列调用 f(key, value)，导出CSV这类不是JSON的格式用
+template <typename Row, typename F>
+void visit_columns(const Row& row, F&& f) {
+	static constexpr auto columns = Row::columns();
+	std::apply([&row, &f](const auto&... cols) {
+		(f(cols.key, row.*(cols.member)), ...);
+	}, columns);
+}
+
+// 按 columns() 的顺序对每一列的 key 调用 f(key)
+template <typename Row, typename F>
+void visit_keys(F&& f) {
+	static constexpr auto columns = Row::columns();
+	std::apply([&f](const auto&... cols) {
+		(f(cols.key), ...);
+	}, columns);
+}
+
+// 把一行写成JSON对象，key 是各列的列名
+template <typename Row>
+void write_json_row(JsonWriter& w, const Row& row) {
+	w.begin_object();
+	visit_columns(row, [&w](std::string_view key, const auto& value) {
+		w.key(key);
+		write_json_value(w, value);
+	});
+	w.end_object();
+}
+
+// students 表
+struct StudentRow {
+	int id;
+	std::string_view name;
+	int class_no;
+	int password;
+	std::string_view phone_number;
+	int gender;
+	std::string_view wish;
+
+	static constexpr auto columns() {
+		return std::make_tuple(
+			column("id", &StudentRow::id),
+			column("name", &StudentRow::name),
+			column("class", &StudentRow::class_no),
+			column("password", &StudentRow::password),
+			column("phone_number", &StudentRow::phone_number),
+			column("gender", &StudentRow::gender),
+			column("wish", &StudentRow::wish));
+	}
+};
+
+// teachers 表
+struct TeacherRow {
+	int id;
+	std::string_view name;
+	std::string_view course_name;
+	int password;
+	std::string_view course1;
+	std::string_view course2;
+
+	static constexpr auto columns() {
+		return std::make_tuple(
+			column("id", &TeacherRow::id),
+			column("name", &TeacherRow::name),
+			column("course_name", &TeacherRow::course_name),
+			column("password", &TeacherRow::password),
+			column("course1", &TeacherRow::course1),
+			column("course2", &TeacherRow::course2));
+	}
+};
+
+// enrollments 表里学生的一门课和成绩
+struct EnrollmentRow {
+	int student_id;
+	std::string_view course_id;
+	int score;
+
+	static constexpr auto columns() {
+		return std::make_tuple(
+			column("student_id", &EnrollmentRow::student_id),
+			column("course_id", &EnrollmentRow::course_id),
+			column("score", &EnrollmentRow::score));
+	}
+};
+
+// /get_course 名单的一行，enrollments e JOIN students s
+struct RosterRow {
+	int id;
+	std::string_view name;
+	int class_no;
+	int score;
+	bool able;
+
+	static constexpr auto columns() {
+		return std::make_tuple(
+			column("s.id", &RosterRow::id),
+			column("s.name", &RosterRow::name),
+			column("s.class", &RosterRow::class_no),
+			column("e.score", &RosterRow::score),
+			column("e.able_to_revise AS able", &RosterRow::able));
+	}
+};
+
+// 导出的学生名单：students 表去掉密码
+struct StudentExportRow {
+	int id;
+	std::string_view name;
+	int class_no;
+	std::string_view phone_number;
+	int gender;
+	std::string_view wish;
+
+	static constexpr auto columns() {
+		return std::make_tuple(
+			column("id", &StudentExportRow::id),
+			column("name", &StudentExportRow::name),
+			column("class", &StudentExportRow::class_no),
+			column("phone_number", &StudentExportRow::phone_number),
+			column("gender", &StudentExportRow::gender),
+			column("wish", &StudentExportRow::wish));
+	}
+};
+
+// 导出的成绩单，enrollments e JOIN students s
+struct GradeRow {
+	int student_id;
+	std::string_view name;
+	int class_no;
+	std::string_view course_id;
+	int score;
+
+	static constexpr auto columns() {
+		return std::make_tuple(
+			column("e.student_id", &GradeRow::student_id),
+			column("s.name", &GradeRow::name),
+			column("s.class", &GradeRow::class_no),
+			column("e.course_id", &GradeRow::course_id),
+			column("e.score", &GradeRow::score));
+	}
+};
+
+// requests_student 表：学生申请修改个人信息
+struct InfoChangeRequest {
+	std::string_view req_id;
+	int id;
+	std::string_view name;
+	int gender;
+	std::string_view phone_number;
+	std::string_view wish;
+
+	static constexpr auto columns() {
+		return std::make_tuple(
+			column("req_id", &InfoChangeRequest::req_id),
+			column("id", &InfoChangeRequest::id),
+			column("name", &InfoChangeRequest::name),
+			column("gender", &InfoChangeRequest::gender),
+			column("phone_number", &InfoChangeRequest::phone_number),
+			column("wish", &InfoChangeRequest::wish));
+	}
+};
+
+// requests_teacher 表：老师申请修改成绩
+struct ScoreChangeRequest {
+	std::string_view req_id;
+	int stu_id;
+	std::string_view option;
+	int new_score;
+	std::string_view course_id;
+
+	static constexpr auto columns() {
+		return std::make_tuple(
+			column("req_id", &ScoreChangeRequest::req_id),
+			column("stu_id", &ScoreChangeRequest::stu_id),
+			column("option", &ScoreChangeRequest::option),
+			column("new_score", &ScoreChangeRequest::new_score),
+			column("course_id", &ScoreChangeRequest::course_id));
+	}
+};
@@ -0,0 +1,178 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#include "roster_cache.h"
+#include "json_writer.h"
+
+#include <algorithm>
+#include <functional>
+
+using namespace std;
+
+namespace {
+
+// 一行里 id、name、class 之后的部分，和 JsonWriter 写出来的一样
+void render_tail(int score, bool able, string& out) {
+	out += ",\"score\":";
+	json_int(score, out);
+	out += able ? ",\"able\":true}" : ",\"able\":false}";
+}
+
+} // namespace
+
+RosterEntry RosterCache::make_entry(int id, string_view name, int class_no, int score, bool able) {
+	RosterEntry entry{id, score, able, 0, {}};
+	JsonWriter w(entry.row);
+	w.begin_object();
+	w.key("id"); w.value(id);
+	w.key("name"); w.value(name);
+	w.key("class"); w.value(class_no);
+	entry.tail = static_cast<uint32_t>(entry.row.size());
+	render_tail(score, able, entry.row);
+	return entry;
+}
+
+void RosterCache::join(Roster& roster) {
+	size_t total = 2;
+	for (const auto& entry : roster.entries)
+		total += entry.row.size() + 1;
+
+	auto json = make_shared<string>();
+	json->reserve(total);
+	*json += "[";
+	for (size_t i = 0; i < roster.entries.size(); i++) {
+		if (i)
+			*json += ",";
+		*json += roster.entries[i].row;
+	}
+	*json += "]";
+	roster.json = move(json);
+	roster.version = next_version_.fetch_add(1, memory_order_relaxed);
+	roster.dirty = false;
+}
+
+RosterCache::Shard& RosterCache::shard_of(const string& course_id) {
+	return shards_[hash<string>()(course_id) % kShards];
+}
+
+void RosterCache::publish(Shard& shard, const string& course_id, RosterSnapshot snapshot) {
+	auto published = make_unique<Published>(shard.published.current());
+	if (snapshot.json)
+		(*published)[course_id] = move(snapshot);
+	else
+		published->erase(course_id);
+	shard.published.store(move(published));
+}
+
+RosterSnapshot RosterCache::get(const string& course_id) {
+	RosterSnapshot snapshot = shard_of(course_id).published.read([&course_id](const Published& published) {
+		auto it = published.find(course_id);
+		return it == published.end() ? RosterSnapshot{nullptr, 0} : it->second;
+	});
+
+	(snapshot.json ? hits_ : misses_).fetch_add(1, memory_order_relaxed);
+	return snapshot;
+}
+
+RosterCache::Generation RosterCache::generation(const string& course_id) {
+	return shard_of(course_id).generation.load(memory_order_acquire);
+}
+
+RosterSnapshot RosterCache::put(const string& course_id, vector<RosterEntry> entries, Generation gen) {
+	Roster roster;
+	roster.entries = move(entries);
+	join(roster);
+
+	RosterSnapshot result{roster.json, roster.version};
+
+	// 没有学生的课程不缓存，避免随便传来的课程号把缓存撑大
+	if (roster.entries.empty())
+		return result;
+
+	auto& shard = shard_of(course_id);
+	lock_guard<mutex> lock(shard.write_mtx);
+	if (shard.generation.load(memory_order_relaxed) == gen) {
+		shard.rosters[course_id] = move(roster);
+		publish(shard, course_id, result);
+	}
+	return result;
+}
+
+void RosterCache::patch(const string& course_id, int stu_id, int score, optional<bool> able) {
+	auto& shard = shard_of(course_id);
+	lock_guard<mutex> lock(shard.write_mtx);
+	shard.generation.fetch_add(1, memory_order_release);
+
+	auto it = shard.rosters.find(course_id);
+	if (it == shard.rosters.end())
+		return;
+
+	Roster& roster = it->second;
+	auto pos = lower_bound(roster.entries.begin(), roster.entries.end(), stu_id,
+		[](const RosterEntry& e, int id) { return e.id < id; });
+	if (pos == roster.entries.end() || pos->id != stu_id) {
+		// 名单里没有这个学生（比如新选了这门课），只能整门课重新加载
+		shard.rosters.erase(it);
+		publish(shard, course_id, {nullptr, 0});
+		return;
+	}
+
+	pos->score = score;
+	if (able)
+		pos->able = *able;
+
+	pos->row.resize(pos->tail);
+	render_tail(pos->score, pos->able, pos->row);
+
+	// 同一个任务里同一门课连续修改时，只在 publish_pending() 里拼接一次
+	if (!roster.dirty) {
+		roster.dirty = true;
+		shard.pending.push_back(course_id);
+	}
+}
+
+void RosterCache::publish_pending() {
+	for (auto& shard : shards_) {
+		lock_guard<mutex> lock(shard.write_mtx);
+		for (const auto& course_id : shard.pending) {
+			// 期间可能已经被 put/invalidate 替换或删掉
+			auto it = shard.rosters.find(course_id);
+			if (it == shard.rosters.end() || !it->second.dirty)
+				continue;
+			join(it->second);
+			publish(shard, course_id, {it->second.json, it->second.version});
+		}
+		shard.pending.clear();
+	}
+}
+
+void RosterCache::invalidate(const string& course_id) {
+	auto& shard = shard_of(course_id);
+	lock_guard<mutex> lock(shard.write_mtx);
+	shard.generation.fetch_add(1, memory_order_release);
+	if (shard.rosters.erase(course_id))
+		publish(shard, course_id, {nullptr, 0});
+}
+
+void RosterCache::clear() {
+	for (auto& shard : shards_) {
+		lock_guard<mutex> lock(shard.write_mtx);
+		shard.generation.fetch_add(1, memory_order_release);
+		shard.rosters.clear();
+		shard.pending.clear();
+		shard.published.store(make_unique<const Published>());
+	}
+}
+
+size_t RosterCache::size() {
+	size_t n = 0;
+	for (auto& shard : shards_) {
+		lock_guard<mutex> lock(shard.write_mtx);
+		n += shard.rosters.size();
+	}
+	return n;
+}
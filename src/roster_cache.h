@@ -0,0 +1,111 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#pragma once
+
+#include "snapshot_ptr.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// /get_course 名单里的一行和它序列化好的JSON对象。
+// tail 是 ,"score": 开始的位置，改分时只重写后面这一段，姓名不用另外保存
+struct RosterEntry {
+	int id;
+	int score;
+	bool able;
+	std::uint32_t tail;
+	std::string row;
+};
+
+// 缓存里取出的名单：序列化好的JSON和它的版本号
+struct RosterSnapshot {
+	std::shared_ptr<const std::string> json;
+	std::uint64_t version;
+};
+
+/*
+ 课程名单的缓存，/get_course 命中时直接返回序列化好的JSON，不查SQL也不构造 crow::json::wvalue。
+
+ 每门课保存按学号排序的名单，每一行带着单独序列化好的JSON片段。
+ 录入成绩、审核通过改分时用 patch() 只重新序列化被修改的那一行，
+ 一个写任务里的修改都做完后调用 publish_pending()，每门被修改的课只拼接、发布一次。
+ 每次发布后名单的版本号都会变，/get_course 把它作为ETag返回。
+
+ 和 RecordCache 一样，拼接好的名单按课程号分片，每个分片是一张不可修改的map，
+ 用 SnapshotPtr 发布（RCU，见 snapshot_ptr.h），get() 不加任何锁。
+ 名单和每一行的JSON只有修改的一方才会访问，由分片的 write_mtx 保护。
+ patch() 之后、publish_pending() 之前，读到的还是修改前发布的名单。
+
+ 读数据库前先记下 generation()，put 时版本变了就不放进缓存，避免把修改之前读到的旧名单放进去。
+*/
+class RosterCache {
+public:
+	using Generation = std::uint64_t;
+
+	// 没有缓存时返回空的 json
+	RosterSnapshot get(const std::string& course_id);
+	Generation generation(const std::string& course_id);
+
+	// 放入从数据库读到的名单（需按学号排序），返回序列化好的结果；版本已变化时不放入缓存，但仍返回序列化结果
+	RosterSnapshot put(const std::string& course_id, std::vector<RosterEntry> entries, Generation gen);
+
+	// 修改某个学生在这门课的成绩，able为空表示不改；课程没有缓存时只更新版本号。
+	// 修改要等 publish_pending() 之后才能读到
+	void patch(const std::string& course_id, int stu_id, int score, std::optional<bool> able);
+	// 把 patch() 改过的名单重新拼接后发布
+	void publish_pending();
+	void invalidate(const std::string& course_id);
+	void clear();
+
+	std::uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+	std::uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+	std::size_t size();
+
+	// 从查询结果直接序列化一行，name 只在调用期间有效
+	static RosterEntry make_entry(int id, std::string_view name, int class_no, int score, bool able);
+
+private:
+	static constexpr std::size_t kShards = 64;
+
+	struct Roster {
+		std::vector<RosterEntry> entries;
+		std::shared_ptr<const std::string> json; // 拼接后的数组
+		std::uint64_t version;
+		bool dirty = false; // patch() 改过，还没有重新拼接
+	};
+
+	using Published = std::unordered_map<std::string, RosterSnapshot>;
+
+	struct Shard {
+		SnapshotPtr<Published> published;
+		std::atomic<Generation> generation{0};
+
+		// 下面的只在持有 write_mtx 时访问
+		std::mutex write_mtx;
+		std::unordered_map<std::string, Roster> rosters;
+		std::vector<std::string> pending; // dirty 的课程
+	};
+
+	Shard& shard_of(const std::string& course_id);
+	void join(Roster& roster);
+	// 复制发布的map，把这门课改成 snapshot（json为空表示拿掉）后替换，需要持有 write_mtx
+	static void publish(Shard& shard, const std::string& course_id, RosterSnapshot snapshot);
+
+	std::array<Shard, kShards> shards_;
+	std::atomic<std::uint64_t> next_version_{1};
+	std::atomic<std::uint64_t> hits_{0};
+	std::atomic<std::uint64_t> misses_{0};
+};
@@ -0,0 +1,1312 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ *
+ * This project uses the following third-party libraries:
+ *
+ * 1. Crow Framework
+ *    Copyright (c) 2014-2017, ipkn
+ *                     2020-2022, CrowCpp
+ *    Licensed under the BSD 3-Clause License.
+ *
+ * 2. nlohmann/json Library
+ *    Copyright (c) 2013-2023, Niels Lohmann
+ *    Licensed under the MIT License.
+ */
+
+#include "routes.h"
+#include "approvals.h"
+#include "async_response.h"
+#include "backup.h"
+#include "batch_progress.h"
+#include "connection.h"
+#include "course_stats.h"
+#include "csv_import.h"
+#include "db_executor.h"
+#include "db_writer.h"
+#include "enrollments.h"
+#include "export.h"
+#include "json_writer.h"
+#include "metrics.h"
+#include "record_cache.h"
+#include "repository.h"
+#include "roster_cache.h"
+#include "sql_profiler.h"
+#include <sqlite3.h>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using namespace std;
+
+// 注册路由时把URL模板登记到 metrics，/metrics 按模板分组统计，而不是按实际的URL
+#define ROUTE(url) (metrics.add_route(url), CROW_ROUTE(app, url))
+
+// 管理员登录时在cookie里写入了 session_type=admin
+static bool is_admin(const crow::request& req) {
+	return req.get_header_value("Cookie").find("session_type=admin") != string::npos;
+}
+
+// 学生登录成功后返回的信息
+static void write_user_info(JsonWriter& w, const StudentRecord& record) {
+	w.begin_object();
+	w.key("id"); w.value(record.id);
+	w.key("name"); w.value(record.name);
+	w.key("class"); w.value(record.class_no);
+	w.key("phone_number"); w.value(record.phone_number);
+	w.key("gender"); w.value(record.gender);
+	w.key("wish"); w.value(record.wish);
+
+	// 旧前端只认识前两门课的 course1/score1、course2/score2
+	static constexpr const char* legacy_course[] = {"course1", "course2"};
+	static constexpr const char* legacy_score[] = {"score1", "score2"};
+	for(size_t n = 0; n < 2 && n < record.courses.size(); n++) {
+		w.key(legacy_course[n]); w.value(record.courses[n].course_id);
+		w.key(legacy_score[n]); w.value(record.courses[n].score);
+	}
+
+	w.key("courses");
+	w.begin_array();
+	for(const auto& c : record.courses) {
+		w.begin_object();
+		w.key("course_id"); w.value(c.course_id);
+		w.key("score"); w.value(c.score);
+		w.end_object();
+	}
+	w.end_array();
+	w.end_object();
+}
+
+// 老师登录成功后返回的信息
+static void write_user_info(JsonWriter& w, const TeacherRecord& record) {
+	w.begin_object();
+	w.key("id"); w.value(record.id);
+	w.key("name"); w.value(record.name);
+	w.key("course_num1"); w.value(record.course1);
+	w.key("course_num2"); w.value(record.course2);
+	w.key("course_name"); w.value(record.course_name);
+	w.end_object();
+}
+
+// 核对学生/老师的密码，生成登录的响应。record 为空表示账号不存在
+template <typename Record>
+static crow::response login_response(const shared_ptr<const Record>& record, int input_id, int input_pwd, const string& user_type) {
+	if(!record)
+		return crow::response(401, "Incorrect username");
+	if(input_pwd != record->password)
+		return crow::response(401, "Incorrect password");
+
+	crow::response res;
+
+	// 在cookie中保存id和type来记录登录状态
+	res.add_header("Set-Cookie", "session_id="+ to_string(input_id) + ",session_type=" + user_type + "; HttpOnly; Path=/;");
+
+	// 登录用户的信息直接写成JSON存入响应体（见 json_writer.h）
+	string& user_info = json_buffer();
+	JsonWriter w(user_info);
+	write_user_info(w, *record);
+	res.body = user_info;
+
+	return res;
+}
+
+// 课程名单的响应，版本号作为ETag，名单没变时客户端可以用 If-None-Match 拿到304
+static crow::response roster_response(const RosterSnapshot& roster, const string& if_none_match) {
+	string etag = "\"" + to_string(roster.version) + "\"";
+	if(if_none_match == etag) {
+		crow::response res(304);
+		res.add_header("ETag", etag);
+		return res;
+	}
+
+	crow::response res;
+	res.add_header("ETag", etag);
+	res.body = *roster.json;
+
+	return res;
+}
+
+/*
+ /admin/requests 的一页：Row 是 InfoChangeRequest 或 ScoreChangeRequest（见 repository.h），
+ 每一行的 string_view 直接从SQLite的内存转义写进输出缓冲区。sql 要多取一条，用来判断后面还有没有
+*/
+template <typename Row>
+static crow::response request_page(Connection& conn, const string& sql, const string& after, int limit) {
+	auto stmt = conn.prepare(sql);
+	if (!stmt) {
+		cerr << "SQL Error: " << sqlite3_errmsg(conn.get()) << endl;
+		return crow::response(500, "Database error");
+	}
+
+	sqlite3_bind_text(stmt, 1, after.c_str(), -1, SQLITE_STATIC);
+	sqlite3_bind_int(stmt, 2, limit + 1);
+
+	string& page = json_buffer();
+	JsonWriter w(page);
+	w.begin_object();
+	w.key("items");
+	w.begin_array();
+
+	int count = 0;
+	bool has_more = false;
+	string cursor; // 本页最后一条的req_id，作为下一页的游标
+	for_each_row<Row>(stmt, [&](const Row& row) {
+		if (count == limit) {
+			has_more = true;
+			return;
+		}
+		write_json_row(w, row);
+		// req_id 在下一次 sqlite3_step 之后就失效了，所以在这一页的最后一行拷贝出来
+		if (++count == limit)
+			cursor = string(row.req_id);
+	});
+	w.end_array();
+
+	w.key("has_more");
+	w.value(has_more);
+	w.key("next_cursor");
+	if (has_more)
+		w.value(cursor);
+	else
+		w.null();
+	w.end_object();
+
+	crow::response res;
+	res.add_header("Content-Type", "application/json");
+	res.body = page;
+	return res;
+}
+
+/*
+ /insert_score 的一行。body 在写线程的任务里是 const 的，const 的 operator[] 访问不存在的key是未定义行为
+ （Release下 JSON_ASSERT 不检查），所以这里先用 find 确认每个字段都在
+*/
+static bool valid_score_row(const nlohmann::json& row) {
+	if(!row.is_object())
+		return false;
+	auto stu_id = row.find("stu_id");
+	auto new_score = row.find("new_score");
+	if(stu_id == row.end() || !stu_id->is_number_integer() || new_score == row.end() || !new_score->is_number_integer())
+		return false;
+
+	// 每一行用 course_id 指定课程，旧前端用 option（score1/score2）指定学生的第几门课。
+	// 两个都可以不给，但给了就必须是字符串，否则后面的 value("course_id", "") 会抛 type_error，整批变成500
+	auto course_id = row.find("course_id");
+	auto option = row.find("option");
+	bool has_course_id = course_id != row.end();
+	bool has_option = option != row.end();
+	if((has_course_id && !course_id->is_string()) || (has_option && !option->is_string()))
+		return false;
+	return has_course_id || has_option;
+}
+
+// /course_stats 的响应
+static crow::response stats_response(const string& course_id, const ScoreStats& stats) {
+	string& out = json_buffer();
+	JsonWriter w(out);
+	w.begin_object();
+	w.key("course_id"); w.value(course_id);
+	w.key("count"); w.value(static_cast<int64_t>(stats.count));
+	w.key("ungraded"); w.value(static_cast<int64_t>(stats.ungraded));
+	if(stats.count) {
+		w.key("mean"); w.value(stats.mean);
+		w.key("stddev"); w.value(stats.stddev);
+		w.key("min"); w.value(stats.min);
+		w.key("max"); w.value(stats.max);
+		w.key("median"); w.value(stats.median);
+		w.key("percentiles");
+		w.begin_object();
+		w.key("p10"); w.value(stats.p10);
+		w.key("p25"); w.value(stats.p25);
+		w.key("p75"); w.value(stats.p75);
+		w.key("p90"); w.value(stats.p90);
+		w.key("p99"); w.value(stats.p99);
+		w.end_object();
+	}
+	w.key("histogram");
+	w.begin_array();
+	for(size_t i = 0; i < stats.histogram.size(); i++) {
+		w.begin_object();
+		w.key("from"); w.value(static_cast<int>(i * 10));
+		w.key("to"); w.value(static_cast<int>(i == 9 ? 100 : i * 10 + 9));
+		w.key("count"); w.value(static_cast<int64_t>(stats.histogram[i]));
+		w.end_object();
+	}
+	w.end_array();
+	w.end_object();
+
+	crow::response res;
+	res.add_header("Content-Type", "application/json");
+	res.body = out;
+	return res;
+}
+
+// /admin/backup 的响应
+static crow::response backup_response(int code, const BackupStatus& status) {
+	string& out = json_buffer();
+	JsonWriter w(out);
+	w.begin_object();
+	w.key("running"); w.value(status.running);
+	w.key("file"); w.value(status.file);
+	if(!status.error.empty()) {
+		w.key("error"); w.value(status.error);
+	}
+	w.key("pages"); w.value(status.page_count);
+	w.key("remaining"); w.value(status.remaining);
+	w.key("steps"); w.value(static_cast<int64_t>(status.steps));
+	w.key("started_at"); w.value(status.started_at);
+	w.key("seconds"); w.value(status.seconds);
+	w.key("completed"); w.value(static_cast<int64_t>(status.completed));
+	w.key("latency");
+	w.begin_object();
+	w.key("p99_before_ms"); w.value(status.p99_before_ms);
+	w.key("p99_during_ms"); w.value(status.p99_during_ms);
+	w.key("requests_during"); w.value(static_cast<int64_t>(status.requests_during));
+	w.end_object();
+	w.end_object();
+
+	crow::response res(code);
+	res.add_header("Content-Type", "application/json");
+	res.body = out;
+	return res;
+}
+
+// /admin/sql_profile 的响应，耗时都换算成毫秒
+static crow::response sql_profile_response(SqlProfiler& profiler, size_t limit, SqlProfiler::Order order) {
+	string& out = json_buffer();
+	JsonWriter w(out);
+	w.begin_object();
+	w.key("slow_ms"); w.value(static_cast<int64_t>(profiler.slow_threshold().count()));
+	w.key("slow_count"); w.value(static_cast<int64_t>(profiler.slow_count()));
+	w.key("statements");
+	w.begin_array();
+	for(const auto& s : profiler.top(limit, order)) {
+		w.begin_object();
+		w.key("sql"); w.value(s.sql);
+		w.key("count"); w.value(static_cast<int64_t>(s.count));
+		w.key("total_ms"); w.value(s.total_ns / 1e6);
+		w.key("mean_ms"); w.value(s.count ? s.total_ns / 1e6 / s.count : 0.0);
+		w.key("max_ms"); w.value(s.max_ns / 1e6);
+		w.key("full_scan_steps"); w.value(static_cast<int64_t>(s.full_scan_steps));
+		w.key("vm_steps"); w.value(static_cast<int64_t>(s.vm_steps));
+		if(!s.plan.empty()) {
+			w.key("plan"); w.value(s.plan);
+		}
+		w.end_object();
+	}
+	w.end_array();
+	w.end_object();
+
+	crow::response res;
+	res.add_header("Content-Type", "application/json");
+	res.body = out;
+	return res;
+}
+
+static double seconds_since(chrono::steady_clock::time_point start) {
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// /admin/import 的导入状态，在写线程的各个任务之间传递
+struct OnlineImport {
+	// body 是请求体本身，不拷贝；异步handler的 req 一直有效到 res.end() 之后，导入期间都可以读
+	OnlineImport(ImportKind kind, string kind_name, string_view body)
+		: kind_name(move(kind_name)), size(body.size()), buf(body), in(&buf), importer(kind, in) {}
+
+	string kind_name;
+	size_t size;
+	MemoryStreamBuf buf;
+	istream in;
+	CsvImporter importer;
+	shared_ptr<BatchProgress::Counter> progress;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+};
+
+/*
+ 在写线程里导入下一段，提交后接着提交下一段，直到导完再回复。
+ 每段是一个单独的写任务（一个事务），所以导入大文件时其他写请求不用等整个文件导完。
+*/
+static void import_next_chunk(DbWriter& writer, RecordCache& cache, RosterCache& rosters, ScoreColumns& scores,
+		shared_ptr<OnlineImport> state, const crow::request& req, crow::response& res) {
+	const size_t rows_per_chunk = 20000;
+
+	writer.submit([&writer, &cache, &rosters, &scores, state, rows_per_chunk](Connection& conn) {
+		state->importer.import_rows(conn, rows_per_chunk);
+		if(state->progress)
+			state->progress->done.store(state->importer.done() ? state->size : state->buf.position(), memory_order_relaxed);
+
+		// 改动的行太多，逐条刷新不如直接清空；最后一段提交后再把学生和老师重新读进快照
+		writer.after_commit([&cache, &rosters, &scores, &conn, last = state->importer.done()] {
+			cache.clear();
+			rosters.clear();
+			scores.clear();
+			if(last && !cache.load_all(conn))
+				cerr << "Can't reload students and teachers: " << sqlite3_errmsg(conn.get()) << endl;
+		});
+		return crow::response(200);
+	}, [&writer, &cache, &rosters, &scores, state, &req, &res](crow::response result) {
+		if(result.code == 200 && !state->importer.done()) {
+			import_next_chunk(writer, cache, rosters, scores, state, req, res);
+			return;
+		}
+
+		if(state->progress)
+			state->progress->finished.store(true, memory_order_release);
+		if(result.code == 200) {
+			result.add_header("Content-Type", "application/json");
+			result.body = import_summary(state->kind_name, state->importer.stats(), seconds_since(state->start));
+		}
+		complete_response(req, res, move(result));
+	});
+}
+
+void register_routes(ServerApp& app, Services& services) {
+	DbWriter& writer = services.writer;
+	DbExecutor& readers = services.readers;
+	RecordCache& cache = services.cache;
+	RosterCache& rosters = services.rosters;
+	ScoreColumns& scores = services.scores;
+	BatchProgress& batches = services.batches;
+	ExportDirectory& exports = services.exports;
+	DbBackup& backup = services.backup;
+	Metrics& metrics = services.metrics;
+	SqlProfiler& profiler = services.profiler;
+
+	app.get_middleware<LatencyRecorder>().metrics = &metrics;
+	writer.set_metrics(&metrics);
+	readers.set_metrics(&metrics);
+	writer.set_profiler(profiler);
+	readers.set_profiler(profiler);
+
+	// 登录函数
+	ROUTE("/login").methods("POST"_method)([&readers, &cache](const crow::request& req, crow::response& res) {
+		// 将请求体加载为json到body变量
+		auto body = crow::json::load(req.body);
+
+		if (!body) {
+			res.code = 401;
+			res.end("Invalid request body");
+			return;
+		}
+
+		// 从json中获取请求的类型，可以是studnet、teacher、admin
+		string user_type = body["user_type"].s();
+
+		// student和teacher类型的登录
+		// 先查内存里的快照，命中就直接返回；没有再交给读线程从数据库读取并放进快照（读取的过程见 record_cache.cpp）
+		if(user_type == "student" || user_type == "teacher") {
+
+			// 从json中获取登录的账号密码
+			int input_id = body["name"].i();
+			int input_pwd = body["password"].i();
+
+			if(user_type == "student") {
+				if(auto record = cache.get_student(input_id)) {
+					res = login_response(record, input_id, input_pwd, user_type);
+					res.end();
+					return;
+				}
+
+				auto gen = cache.student_generation(input_id);
+				readers.submit(req, res, [&cache, input_id, input_pwd, user_type, gen](Connection& conn) {
+					auto record = load_student(conn, input_id);
+					if(record)
+						cache.put_student(record, gen);
+					return login_response(record, input_id, input_pwd, user_type);
+				});
+			}else {
+				if(auto record = cache.get_teacher(input_id)) {
+					res = login_response(record, input_id, input_pwd, user_type);
+					res.end();
+					return;
+				}
+
+				auto gen = cache.teacher_generation(input_id);
+				readers.submit(req, res, [&cache, input_id, input_pwd, user_type, gen](Connection& conn) {
+					auto record = load_teacher(conn, input_id);
+					if(record)
+						cache.put_teacher(record, gen);
+					return login_response(record, input_id, input_pwd, user_type);
+				});
+			}
+			return;
+		}
+
+		// admin类型的登录
+		else if (user_type == "admin") {
+			string name = body["name"].s();
+			string pwd = body["password"].s();
+
+			if(name == "admin" && pwd == "admin") {
+				readers.submit(req, res, [](Connection& conn) {
+					sqlite3* db = conn.get();
+
+					// 待审核的申请可能非常多，登录时只返回数量，具体内容通过 /admin/requests 分页获取
+					auto stmt_stu = conn.prepare("SELECT COUNT(*) FROM requests_student;");
+					auto stmt_tea = conn.prepare("SELECT COUNT(*) FROM requests_teacher;");
+					if(!stmt_stu || !stmt_tea || sqlite3_step(stmt_stu) != SQLITE_ROW || sqlite3_step(stmt_tea) != SQLITE_ROW) {
+						cerr << "SQL Error: " << sqlite3_errmsg(db) << endl;
+						return crow::response(500, "Database error");
+					}
+
+					crow::response res;
+					res.add_header("Set-cookie", "session_id=admin, session_type=admin; HttpOnly; Path=/;");
+
+					string& admin = json_buffer();
+					JsonWriter w(admin);
+					w.begin_object();
+					w.key("students_pending"); w.value(static_cast<int64_t>(sqlite3_column_int64(stmt_stu, 0)));
+					w.key("teachers_pending"); w.value(static_cast<int64_t>(sqlite3_column_int64(stmt_tea, 0)));
+					w.end_object();
+					res.body = admin;
+
+					return res;
+				});
+			}else {
+				res.code = 401;
+				res.end(" You\'re not the administrator");
+			}
+			return;
+		}
+
+
+		res.code = 401;
+		res.end("Default");
+	});
+
+	/*
+	 管理员分页查看待审核的申请，请求体：
+		{"req_type": "student" | "teacher", "after": 上一页返回的next_cursor（第一页不传）, "limit": 每页条数}
+	 按req_id排序，用上一页最后一条的req_id作为游标（keyset分页），
+	 走req_id主键索引直接定位到下一页，不论积压了多少申请、翻到第几页，每页的代价都一样。
+	*/
+	ROUTE("/admin/requests").methods("POST"_method)([&readers](const crow::request& req, crow::response& res) {
+		if (!is_admin(req)) {
+			res.code = 401;
+			res.end(" You\'re not the administrator");
+			return;
+		}
+
+		auto body = crow::json::load(req.body);
+		if (!body || !body.has("req_type")) {
+			res.code = 400;
+			res.end("Invalid request body");
+			return;
+		}
+
+		string req_type = body["req_type"].s();
+		string after = body.has("after") ? string(body["after"].s()) : "";
+
+		// 每页条数的上限，防止一次取出整张表
+		const int max_page_size = 200;
+		int limit = body.has("limit") ? int(body["limit"].i()) : 50;
+		limit = max(1, min(limit, max_page_size));
+
+		// 列由 InfoChangeRequest / ScoreChangeRequest 的 columns() 生成
+		static const string student_sql = "SELECT " + columns_sql<InfoChangeRequest>() + " FROM requests_student WHERE req_id > ? ORDER BY req_id LIMIT ?;";
+		static const string teacher_sql = "SELECT " + columns_sql<ScoreChangeRequest>() + " FROM requests_teacher WHERE req_id > ? ORDER BY req_id LIMIT ?;";
+
+		if (req_type == "student") {
+			readers.submit(req, res, [after, limit](Connection& conn) {
+				return request_page<InfoChangeRequest>(conn, student_sql, after, limit);
+			});
+		} else if (req_type == "teacher") {
+			readers.submit(req, res, [after, limit](Connection& conn) {
+				return request_page<ScoreChangeRequest>(conn, teacher_sql, after, limit);
+			});
+		} else {
+			res.code = 400;
+			res.end("Invalid req_type");
+		}
+	});
+
+	ROUTE("/get_course").methods("POST"_method)([&readers, &rosters](const crow::request& req, crow::response& res) {
+		auto cookie = req.get_header_value("Cookie");
+
+		if(cookie.size() && cookie.find("session_id") != string::npos) {
+			auto body = crow::json::load(req.body);
+			if(!body || !body.has("course_id")) {
+				res.code = 400;
+				res.end("Invalid request body");
+				return;
+			}
+			
+			string course_id = body["course_id"].s();
+			string if_none_match = req.get_header_value("If-None-Match");
+
+			// 先查名单缓存，命中时直接返回序列化好的JSON
+			RosterSnapshot roster = rosters.get(course_id);
+			if(roster.json) {
+				res = roster_response(roster, if_none_match);
+				res.end();
+				return;
+			}
+
+			auto gen = rosters.generation(course_id);
+			readers.submit(req, res, [&rosters, course_id, if_none_match, gen](Connection& conn) {
+				// 在enrollments的(course_id, student_id)索引上做范围扫描，再按主键取学生信息，列见 RosterRow
+				static const string sql = "SELECT " + columns_sql<RosterRow>() +
+					" FROM enrollments e JOIN students s ON s.id = e.student_id WHERE e.course_id = ? ORDER BY e.student_id;";
+
+				auto stmt = conn.prepare(sql);
+				if(!stmt) {
+					cerr << "SQL Error: " << sqlite3_errmsg(conn.get()) << endl;
+					return crow::response(500, "Database error");
+				}
+
+				sqlite3_bind_text(stmt, 1, course_id.c_str(), -1, SQLITE_TRANSIENT);
+				
+				vector<RosterEntry> student_list;
+				for_each_row<RosterRow>(stmt, [&student_list](const RosterRow& row) {
+					student_list.push_back(RosterCache::make_entry(row.id, row.name, row.class_no, row.score, row.able));
+				});
+
+				return roster_response(rosters.put(course_id, move(student_list), gen), if_none_match);
+			});
+			return;
+		}
+
+
+		
+		res.code = 401;
+		res.end("Please login first");
+	});
+	
+	/*
+	 一门课的成绩统计：人数、平均分、标准差、最高/最低分、中位数、百分位数和分数段直方图，请求体：
+		{"course_id": "..."}
+	 在内存里的成绩列上计算（见 course_stats.h），没有缓存时先从 enrollments 读取这门课的成绩。
+	*/
+	ROUTE("/course_stats").methods("POST"_method)([&readers, &scores](const crow::request& req, crow::response& res) {
+		auto cookie = req.get_header_value("Cookie");
+		if(cookie.empty() || cookie.find("session_id") == string::npos) {
+			res.code = 401;
+			res.end("Please login first");
+			return;
+		}
+
+		auto body = crow::json::load(req.body);
+		if(!body || !body.has("course_id")) {
+			res.code = 400;
+			res.end("Invalid request body");
+			return;
+		}
+
+		string course_id = body["course_id"].s();
+		if(auto stats = scores.stats(course_id)) {
+			res = stats_response(course_id, *stats);
+			res.end();
+			return;
+		}
+
+		auto gen = scores.generation(course_id);
+		readers.submit(req, res, [&scores, course_id, gen](Connection& conn) {
+			auto stmt = conn.prepare("SELECT student_id, score FROM enrollments WHERE course_id = ? ORDER BY student_id;");
+			if(!stmt) {
+				cerr << "SQL Error: " << sqlite3_errmsg(conn.get()) << endl;
+				return crow::response(500, "Database error");
+			}
+			sqlite3_bind_text(stmt, 1, course_id.c_str(), -1, SQLITE_TRANSIENT);
+
+			vector<int32_t> ids, course_scores;
+			while(sqlite3_step(stmt) == SQLITE_ROW) {
+				ids.push_back(sqlite3_column_int(stmt, 0));
+				course_scores.push_back(sqlite3_column_int(stmt, 1));
+			}
+
+			return stats_response(course_id, scores.put(course_id, move(ids), move(course_scores), gen));
+		});
+	});
+
+	/*
+	 课程成绩概况：直接读取触发器维护的汇总表（见 course_aggregates.h），不扫描成绩。请求体：
+		{"course_id": "..."}     只要一门课；不传 course_id 时返回所有课程
+	 返回选课人数、有成绩的人数、平均分、标准差和分数段人数；中位数、百分位数见 /course_stats。
+	*/
+	ROUTE("/course_summary").methods("POST"_method)([&readers](const crow::request& req, crow::response& res) {
+		auto cookie = req.get_header_value("Cookie");
+		if(cookie.empty() || cookie.find("session_id") == string::npos) {
+			res.code = 401;
+			res.end("Please login first");
+			return;
+		}
+
+		auto body = crow::json::load(req.body.empty() ? "{}" : req.body);
+		if(!body) {
+			res.code = 400;
+			res.end("Invalid request body");
+			return;
+		}
+		string course_id = body.has("course_id") ? string(body["course_id"].s()) : "";
+
+		readers.submit(req, res, [course_id](Connection& conn) {
+			// 两个查询都按课程号排序，一起往下走就能把分数段对应到课程上
+			auto stmt = conn.prepare(course_id.empty()
+				? "SELECT course_id, enrolled, graded, sum, sum_sq FROM course_aggregates ORDER BY course_id;"
+				: "SELECT course_id, enrolled, graded, sum, sum_sq FROM course_aggregates WHERE course_id = ?;");
+			auto hist_stmt = conn.prepare(course_id.empty()
+				? "SELECT course_id, bucket, count FROM course_histogram ORDER BY course_id, bucket;"
+				: "SELECT course_id, bucket, count FROM course_histogram WHERE course_id = ? ORDER BY bucket;");
+			if(!stmt || !hist_stmt) {
+				cerr << "SQL Error: " << sqlite3_errmsg(conn.get()) << endl;
+				return crow::response(500, "Database error");
+			}
+			if(course_id.size()) {
+				sqlite3_bind_text(stmt, 1, course_id.c_str(), -1, SQLITE_STATIC);
+				sqlite3_bind_text(hist_stmt, 1, course_id.c_str(), -1, SQLITE_STATIC);
+			}
+
+			string& out = json_buffer();
+			JsonWriter w(out);
+			w.begin_array();
+
+			bool hist_row = sqlite3_step(hist_stmt) == SQLITE_ROW;
+			while(sqlite3_step(stmt) == SQLITE_ROW) {
+				string id = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+				int64_t graded = sqlite3_column_int64(stmt, 2);
+				int64_t sum = sqlite3_column_int64(stmt, 3);
+				int64_t sum_sq = sqlite3_column_int64(stmt, 4);
+
+				w.begin_object();
+				w.key("course_id"); w.value(id);
+				w.key("enrolled"); w.value(static_cast<int64_t>(sqlite3_column_int64(stmt, 1)));
+				w.key("graded"); w.value(graded);
+				if(graded) {
+					double mean = double(sum) / graded;
+					w.key("mean"); w.value(mean);
+					w.key("stddev"); w.value(sqrt(max(0.0, double(sum_sq) / graded - mean * mean)));
+				}
+
+				int64_t histogram[10] = {};
+				while(hist_row && id == reinterpret_cast<const char*>(sqlite3_column_text(hist_stmt, 0))) {
+					int bucket = sqlite3_column_int(hist_stmt, 1);
+					if(bucket >= 0 && bucket < 10)
+						histogram[bucket] = sqlite3_column_int64(hist_stmt, 2);
+					hist_row = sqlite3_step(hist_stmt) == SQLITE_ROW;
+				}
+				w.key("histogram");
+				w.begin_array();
+				for(int64_t count : histogram)
+					w.value(count);
+				w.end_array();
+				w.end_object();
+			}
+			w.end_array();
+
+			crow::response res;
+			res.add_header("Content-Type", "application/json");
+			res.body = out;
+			return res;
+		});
+	});
+
+	// 批量录入成绩：整批作为写线程里的一个任务执行，任何一行失败就整体回滚，并返回每一行的处理结果
+	ROUTE("/insert_score").methods("POST"_method)([&writer, &cache, &rosters, &scores](const crow::request& req, crow::response& res) {
+		auto body = nlohmann::json::parse(req.body, nullptr, false);
+
+		if(body.is_discarded() || !body.is_array()) {
+			res.code = 400;
+			res.end("Invalid JSON format, expected an array.");
+			return;
+		}
+
+		writer.submit(req, res, [&writer, &cache, &rosters, &scores, body](Connection& conn) {
+			sqlite3* db = conn.get();
+
+			// 只准备一条语句，整批循环里反复重新绑定使用；准备失败时每一行都记为 database error，仍然返回逐行的结果
+			auto stmt = conn.prepare("UPDATE enrollments SET score = ?, able_to_revise = 0 WHERE student_id = ? AND course_id = ?;");
+			if(!stmt)
+				cerr << "SQL Error:" << sqlite3_errmsg(db) << endl;
+
+			// 原来每一行都是单独的自动提交事务，300个学生就要300次fsync，
+			// 现在整批和同一时间的其他写请求一起提交一次
+			nlohmann::json results = nlohmann::json::array();
+			bool all_ok = true;
+
+			for(const auto& student : body) {
+				nlohmann::json row_result;
+				row_result["stu_id"] = student.contains("stu_id") ? student["stu_id"] : nullptr;
+
+				if(!valid_score_row(student)) {
+					row_result["result"] = "invalid row";
+					results.push_back(row_result);
+					all_ok = false;
+					continue;
+				}
+
+				int stu_id = student.at("stu_id");
+				int new_score = student.at("new_score");
+				string option = student.value("option", "");
+
+				string course_id;
+				if(!resolve_course(conn, stu_id, student.value("course_id", ""), option, course_id)) {
+					row_result["option"] = option;
+					row_result["result"] = "invalid option";
+					results.push_back(row_result);
+					all_ok = false;
+					continue;
+				}
+				row_result["course_id"] = course_id;
+
+				if(!stmt) {
+					row_result["result"] = "database error";
+					results.push_back(row_result);
+					all_ok = false;
+					continue;
+				}
+
+				sqlite3_bind_int(stmt, 1, new_score);
+				sqlite3_bind_int(stmt, 2, stu_id);
+				sqlite3_bind_text(stmt, 3, course_id.c_str(), -1, SQLITE_STATIC);
+
+				int rc = sqlite3_step(stmt);
+				sqlite3_reset(stmt);
+
+				if(rc != SQLITE_DONE) {
+					cerr << "Failed to insert: " << sqlite3_errmsg(db) << endl;
+					row_result["result"] = "database error";
+					all_ok = false;
+				}else if(sqlite3_changes(db) == 0) {
+					row_result["result"] = "student not enrolled";
+					all_ok = false;
+				}else {
+					row_result["result"] = "updated";
+					writer.after_commit([&cache, &rosters, &scores, &conn, stu_id, course_id, new_score] {
+						cache.refresh_student(conn, stu_id);
+						rosters.patch(course_id, stu_id, new_score, false);
+						scores.patch(course_id, stu_id, new_score);
+					});
+				}
+
+				results.push_back(row_result);
+			}
+			// 上面改过的名单在这里一起重新拼接发布，一门课改了多行也只拼接一次
+			writer.after_commit([&rosters] { rosters.publish_pending(); });
+
+			nlohmann::json report;
+			report["results"] = results;
+
+			// 有任何一行失败就返回400，写线程会回滚这个任务做过的全部修改
+			report["committed"] = all_ok;
+			return crow::response(all_ok ? 200 : 400, report.dump());
+		});
+	});
+
+	ROUTE("/revise_score").methods("POST"_method)([&writer](const crow::request& req, crow::response& res) {
+		auto body = crow::json::load(req.body);
+
+		if (!body) {
+			res.code = 400;
+			res.end("Invalid request body");
+			return;
+		}
+
+		string req_id = body["req_time"].s();
+		int stu_id = body["stu_id"].i();
+		string option = body.has("option") ? string(body["option"].s()) : "";
+		string req_course_id = body.has("course_id") ? string(body["course_id"].s()) : "";
+		int new_score = body["new_score"].i();
+
+		writer.submit(req, res, [req_id, stu_id, option, req_course_id, new_score](Connection& conn) {
+			sqlite3* db = conn.get();
+
+			// 申请里记下具体是哪门课，审核时直接按课程号修改成绩
+			string course_id;
+			if(!resolve_course(conn, stu_id, req_course_id, option, course_id)) {
+				return crow::response(400, "Invalid option");
+			}
+
+			string insert_sql = R"(
+				INSERT INTO requests_teacher (req_id, stu_id, option, new_score, course_id)
+				VALUES (?, ?, ?, ?, ?)
+			)";
+			
+			auto insert_stmt = conn.prepare(insert_sql);
+			if(!insert_stmt){
+				cerr << "INSERT SQL Error" << endl;
+				return crow::response(401, "SQL ERROR");
+			}
+
+			sqlite3_bind_text(insert_stmt, 1, req_id.c_str(), -1, SQLITE_STATIC);
+			sqlite3_bind_int(insert_stmt, 2, stu_id);
+			sqlite3_bind_text(insert_stmt, 3, option.c_str(), -1, SQLITE_STATIC);
+			sqlite3_bind_int(insert_stmt, 4, new_score);
+			sqlite3_bind_text(insert_stmt, 5, course_id.c_str(), -1, SQLITE_STATIC);
+
+			if(sqlite3_step(insert_stmt) != SQLITE_DONE) {
+				return crow::response(401, "Failed to revise" , sqlite3_errmsg(db));
+			}
+
+			return crow::response(200, "Successfully");
+		});
+	});
+
+	//处理学生和老师发送过来的请求
+	ROUTE("/unsolvereq").methods("POST"_method)([&writer, &cache, &rosters, &scores](const crow::request& req, crow::response& res){
+		// 将请求体加载为json到body变量
+		auto body = crow::json::load(req.body);
+
+		if (!body) {
+			res.code = 400;
+			res.end("Invalid request body");
+			return;
+		}
+
+		// 从body中获取req_status, req_id和req_type
+		std::string req_status = body["req_status"].s();
+		std::string req_id = body["req_id"].s();
+		std::string req_type = body["req_type"].s();
+
+		// 确认和取消都在写线程的一个事务里完成，具体的数据库操作见 approvals.cpp
+		writer.submit(req, res, [&writer, &cache, &rosters, &scores, req_status, req_id, req_type](Connection& conn) {
+			// 根据req_status的值执行不同的操作
+			if (req_status == "确认") {
+				ApprovalResult result;
+				//老师请求
+				if (req_type == "teacher")
+					result = approve_teacher_request(conn, req_id);
+				//学生请求
+				else if (req_type == "student")
+					result = approve_student_request(conn, req_id);
+				else
+					return crow::response(200, "Default");
+
+				switch (result.status) {
+				case ApprovalStatus::Ok:
+					break;
+				case ApprovalStatus::NotFound:
+					return crow::response(401, "Request not found");
+				case ApprovalStatus::InvalidOption:
+					return crow::response(400, "Invalid option");
+				default:
+					return crow::response(500, "Database error");
+				}
+
+				int stu_id = result.stu_id;
+				if (req_type == "teacher") {
+					writer.after_commit([&cache, &rosters, &scores, &conn, stu_id, course_id = result.course_id, score = result.score] {
+						cache.refresh_student(conn, stu_id);
+						rosters.patch(course_id, stu_id, score, nullopt);
+						rosters.publish_pending();
+						scores.patch(course_id, stu_id, score);
+					});
+				} else
+					writer.after_commit([&cache, &conn, stu_id] { cache.refresh_student(conn, stu_id); });
+				return crow::response(200, "Update successful");
+			} else if (req_status == "取消") {
+				// 取消请求只需要把这条记录删除，记录不存在时什么也不做
+				if (reject_request(conn, req_type, req_id) == ApprovalStatus::DbError)
+					return crow::response(500, "Database error");
+			} 
+
+			return crow::response(200, "Default");
+		});
+	});
+
+	/*
+	 管理员批量审核，所有条目在写线程的一个任务（一个事务）里处理，请求体：
+		{"batch_id": 可选，用来查询进度,
+		 "items": [{"req_type": "teacher" | "student", "req_id": "...", "decision": "approve" | "reject"}, ...]}
+	 decision 也可以用 /unsolvereq 的 "确认"/"取消"。
+	 每个条目外面再包一层 SAVEPOINT，某一条失败只撤销它自己，其他条目照常提交，返回每一条的处理结果。
+	 条目很多时，处理期间可以用 GET /admin/requests/batch/<batch_id> 查询已经处理了多少条。
+	*/
+	ROUTE("/admin/requests/batch").methods("POST"_method)([&writer, &cache, &rosters, &scores, &batches](const crow::request& req, crow::response& res) {
+		if (!is_admin(req)) {
+			res.code = 401;
+			res.end(" You\'re not the administrator");
+			return;
+		}
+
+		auto body = nlohmann::json::parse(req.body, nullptr, false);
+		if (body.is_discarded() || !body.is_object() || !body.contains("items") || !body["items"].is_array()) {
+			res.code = 400;
+			res.end("Invalid request body");
+			return;
+		}
+
+		// 一批太大会长时间占着写线程，其他写请求都得等着
+		const size_t max_batch_items = 20000;
+		nlohmann::json items = move(body["items"]);
+		if (items.size() > max_batch_items) {
+			res.code = 400;
+			res.end("Too many items");
+			return;
+		}
+
+		shared_ptr<BatchProgress::Counter> progress;
+		if (body.contains("batch_id") && body["batch_id"].is_string())
+			progress = batches.start(body["batch_id"].get<string>(), items.size());
+
+		writer.submit([&writer, &cache, &rosters, &scores, items, progress](Connection& conn) {
+			sqlite3* db = conn.get();
+			nlohmann::json results = nlohmann::json::array();
+			size_t applied = 0;
+
+			for (const auto& item : items) {
+				nlohmann::json item_result;
+				item_result["req_id"] = item.is_object() && item.contains("req_id") ? item["req_id"] : nullptr;
+
+				// 字段不是字符串时当作没给，value() 遇到类型不对会抛 type_error，整批都会失败
+				auto string_field = [&item](const char* key) {
+					return item.is_object() && item.contains(key) && item[key].is_string() ? item[key].get<string>() : string();
+				};
+				string req_type = string_field("req_type");
+				string req_id = string_field("req_id");
+				string decision = string_field("decision");
+				bool approve = decision == "approve" || decision == "确认";
+				bool reject = decision == "reject" || decision == "取消";
+
+				if ((req_type != "teacher" && req_type != "student") || req_id.empty() || (!approve && !reject)) {
+					item_result["result"] = "invalid item";
+				} else if (sqlite3_exec(db, "SAVEPOINT item;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+					cerr << "SAVEPOINT error: " << sqlite3_errmsg(db) << endl;
+					return crow::response(500, "Database error");
+				} else {
+					item_result["req_type"] = req_type;
+
+					ApprovalStatus status;
+					ApprovalResult approval;
+					if (reject)
+						status = reject_request(conn, req_type, req_id);
+					else {
+						approval = req_type == "teacher" ? approve_teacher_request(conn, req_id) : approve_student_request(conn, req_id);
+						status = approval.status;
+					}
+
+					switch (status) {
+					case ApprovalStatus::Ok:
+						item_result["result"] = approve ? "approved" : "rejected";
+						break;
+					case ApprovalStatus::NotFound:
+						item_result["result"] = "not found";
+						break;
+					case ApprovalStatus::InvalidOption:
+						item_result["result"] = "invalid option";
+						break;
+					default:
+						item_result["result"] = "database error";
+					}
+
+					if (status == ApprovalStatus::Ok) {
+						sqlite3_exec(db, "RELEASE item;", nullptr, nullptr, nullptr);
+						applied++;
+
+						if (approve) {
+							int stu_id = approval.stu_id;
+							if (req_type == "teacher") {
+								writer.after_commit([&cache, &rosters, &scores, &conn, stu_id, course_id = approval.course_id, score = approval.score] {
+									cache.refresh_student(conn, stu_id);
+									rosters.patch(course_id, stu_id, score, nullopt);
+									scores.patch(course_id, stu_id, score);
+								});
+							} else
+								writer.after_commit([&cache, &conn, stu_id] { cache.refresh_student(conn, stu_id); });
+						}
+					} else
+						// 只撤销这一条的修改，比如 DELETE ... RETURNING 已经删掉的申请
+						sqlite3_exec(db, "ROLLBACK TO item; RELEASE item;", nullptr, nullptr, nullptr);
+				}
+
+				results.push_back(move(item_result));
+				if (progress)
+					progress->done.fetch_add(1, memory_order_relaxed);
+			}
+			writer.after_commit([&rosters] { rosters.publish_pending(); });
+
+			nlohmann::json summary;
+			summary["applied"] = applied;
+			summary["failed"] = results.size() - applied;
+			summary["results"] = move(results);
+			return crow::response(200, summary.dump());
+		}, [&req, &res, progress](crow::response result) {
+			if (progress)
+				progress->finished.store(true, memory_order_release);
+			complete_response(req, res, move(result));
+		});
+	});
+
+	// 查询批量审核的进度
+	ROUTE("/admin/requests/batch/<string>").methods("GET"_method)([&batches](const crow::request& req, const string& batch_id) {
+		if (!is_admin(req)) {
+			return crow::response(401, " You\'re not the administrator");
+		}
+
+		auto status = batches.get(batch_id);
+		if (!status) {
+			return crow::response(404, "Batch not found");
+		}
+
+		crow::json::wvalue progress;
+		progress["total"] = status->total;
+		progress["done"] = status->done;
+		progress["finished"] = status->finished;
+		return crow::response(progress);
+	});
+
+	ROUTE("/info_modify").methods("POST"_method)([&writer](const crow::request& req, crow::response& res) {
+		auto body = crow::json::load(req.body); // 获取请求体中的 JSON
+
+		if (!body) {
+			res.code = 400;
+			res.end("Invalid request body");
+			return;
+		}
+
+		// 从请求体中获取学生的ID和要修改的字段
+		string req_id = body["req_id"].s();
+		int id = body["id"].i();
+		string name = body["name"].s();
+		int gender = body["gender"].i();
+		string phone_number = body["phone_number"].s();
+		string wish = body["wish"].s();
+
+		writer.submit(req, res, [req_id, id, name, gender, phone_number, wish](Connection& conn) {
+			// 插入到 pending_changes 表中，等待管理员审核
+			string sql = "INSERT INTO requests_student (req_id, id, name, gender, phone_number, wish) VALUES (?, ?, ?, ?, ?, ?);";
+			auto stmt = conn.prepare(sql);
+			if (!stmt) {
+				cerr << sqlite3_errmsg(conn.get()) << endl;
+				return crow::response(500, "Database error");
+			}
+			
+			sqlite3_bind_text(stmt, 1, req_id.c_str(), -1, SQLITE_STATIC);
+			sqlite3_bind_int(stmt, 2, id);
+			sqlite3_bind_text(stmt, 3, name.c_str(), -1, SQLITE_STATIC);
+			sqlite3_bind_int(stmt, 4, gender);
+			sqlite3_bind_text(stmt, 5, phone_number.c_str(), -1, SQLITE_STATIC);
+			sqlite3_bind_text(stmt, 6, wish.c_str(), -1, SQLITE_STATIC);
+
+			if (sqlite3_step(stmt) != SQLITE_DONE) {
+				return crow::response(500, "Failed to insert pending change");
+			}
+
+			return crow::response(200, "Your request has been submitted for review");
+		});
+	});
+
+	/*
+	 管理员上传CSV批量导入，POST /admin/import/students|teachers|enrollments，请求体就是CSV文件（格式见 csv_import.h）。
+	 可以在URL后面加 ?batch_id=xxx，导入期间用 GET /admin/requests/batch/xxx 查询进度（total/done 是字节数）。
+	 每2万行一个事务，前面的段已经提交后某一段出错时，返回500，已提交的部分保留。
+	 返回导入的行数、跳过的行数和原因、耗时和每秒行数。
+	*/
+	ROUTE("/admin/import/<string>").methods("POST"_method)([&writer, &cache, &rosters, &scores, &batches](const crow::request& req, crow::response& res, const string& kind_name) {
+		if (!is_admin(req)) {
+			res.code = 401;
+			res.end(" You\'re not the administrator");
+			return;
+		}
+
+		ImportKind kind;
+		if (!parse_import_kind(kind_name, kind)) {
+			res.code = 404;
+			res.end("Unknown import type");
+			return;
+		}
+
+		auto state = make_shared<OnlineImport>(kind, kind_name, req.body);
+		string error;
+		if (!state->importer.read_header(error)) {
+			res.code = 400;
+			res.end(error);
+			return;
+		}
+
+		if (const char* batch_id = req.url_params.get("batch_id"))
+			state->progress = batches.start(batch_id, state->size);
+
+		import_next_chunk(writer, cache, rosters, scores, state, req, res);
+	});
+
+	/*
+	 管理员导出学生表或成绩单：GET /admin/export/students|enrollments?format=csv|ndjson&course_id=...&class=...
+	 format 默认 csv，course_id 和 class 都可以不传。格式见 export.h。
+	 读线程把结果一行一行写进 exports 目录下的临时文件，再由Crow分块发送，导出多大的表内存占用都不变。
+	*/
+	ROUTE("/admin/export/<string>").methods("GET"_method)([&readers, &exports](const crow::request& req, crow::response& res, const string& kind_name) {
+		if (!is_admin(req)) {
+			res.code = 401;
+			res.end(" You\'re not the administrator");
+			return;
+		}
+
+		ExportKind kind;
+		if (!parse_export_kind(kind_name, kind)) {
+			res.code = 404;
+			res.end("Unknown export type");
+			return;
+		}
+
+		const char* format_name = req.url_params.get("format");
+		ExportFormat format = ExportFormat::Csv;
+		if (format_name && !parse_export_format(format_name, format)) {
+			res.code = 400;
+			res.end("format must be csv or ndjson");
+			return;
+		}
+
+		ExportFilter filter;
+		if (const char* course_id = req.url_params.get("course_id"))
+			filter.course_id = course_id;
+		if (const char* class_no = req.url_params.get("class")) {
+			char* end;
+			long value = strtol(class_no, &end, 10);
+			if (*class_no == '\0' || *end != '\0') {
+				res.code = 400;
+				res.end("class must be an integer");
+				return;
+			}
+			filter.class_no = static_cast<int>(value);
+		}
+
+		readers.submit(req, res, [&exports, kind, kind_name, format, filter](Connection& conn) {
+			string path = exports.new_file();
+			write_export(conn, kind, format, filter, path);
+
+			crow::response res;
+			res.set_static_file_info_unsafe(path);
+			res.set_header("Content-Type", format == ExportFormat::Csv ? "text/csv; charset=utf-8" : "application/x-ndjson");
+			res.set_header("Content-Disposition", "attachment; filename=\"" + kind_name + (format == ExportFormat::Csv ? ".csv\"" : ".ndjson\""));
+			return res;
+		});
+	});
+
+	/*
+	 在线热备份，备份文件在运行目录的 backups 下（见 backup.h）。
+	 POST 开始一次备份，马上返回202，已经在备份时返回409；GET 查询进度、耗时，以及备份前后所有请求的p99。
+	*/
+	ROUTE("/admin/backup").methods("POST"_method)([&backup](const crow::request& req) {
+		if (!is_admin(req)) {
+			return crow::response(401, " You\'re not the administrator");
+		}
+
+		bool started = backup.start();
+		return backup_response(started ? 202 : 409, backup.status());
+	});
+
+	ROUTE("/admin/backup").methods("GET"_method)([&backup](const crow::request& req) {
+		if (!is_admin(req)) {
+			return crow::response(401, " You\'re not the administrator");
+		}
+
+		return backup_response(200, backup.status());
+	});
+
+	/*
+	 各条SQL的执行次数和耗时（见 sql_profiler.h），只有管理员可以查看。
+	 GET ?top=20&order=total|max|count 取耗时最多的前几条；
+	 POST {"slow_ms": 50, "reset": true} 修改慢查询日志的阈值（0为不记录）或清空统计，两项都可以不传。
+	*/
+	ROUTE("/admin/sql_profile").methods("GET"_method)([&profiler](const crow::request& req) {
+		if (!is_admin(req)) {
+			return crow::response(401, " You\'re not the administrator");
+		}
+
+		size_t limit = 20;
+		if (const char* top = req.url_params.get("top"))
+			limit = max(1, min(atoi(top), 1000));
+
+		SqlProfiler::Order order = SqlProfiler::Order::Total;
+		if (const char* name = req.url_params.get("order")) {
+			if (string(name) == "max")
+				order = SqlProfiler::Order::Max;
+			else if (string(name) == "count")
+				order = SqlProfiler::Order::Count;
+			else if (string(name) != "total")
+				return crow::response(400, "order must be total, max or count");
+		}
+		return sql_profile_response(profiler, limit, order);
+	});
+
+	ROUTE("/admin/sql_profile").methods("POST"_method)([&profiler](const crow::request& req) {
+		if (!is_admin(req)) {
+			return crow::response(401, " You\'re not the administrator");
+		}
+
+		auto body = crow::json::load(req.body);
+		if (!body) {
+			return crow::response(400, "Invalid request body");
+		}
+		if (body.has("slow_ms")) {
+			if (body["slow_ms"].t() != crow::json::type::Number || body["slow_ms"].i() < 0)
+				return crow::response(400, "slow_ms must be a non-negative number");
+			profiler.set_slow_threshold(chrono::milliseconds(body["slow_ms"].i()));
+		}
+		if (body.has("reset") && body["reset"].t() == crow::json::type::True)
+			profiler.reset();
+		return sql_profile_response(profiler, 20, SqlProfiler::Order::Total);
+	});
+
+	// 缓存命中情况，只有管理员可以查看
+	ROUTE("/cache_stats").methods("GET"_method)([&cache, &rosters](const crow::request& req) {
+		if (!is_admin(req)) {
+			return crow::response(401, " You\'re not the administrator");
+		}
+
+		uint64_t hits = cache.hits();
+		uint64_t misses = cache.misses();
+
+		crow::json::wvalue stats;
+		stats["record_cache"]["hits"] = hits;
+		stats["record_cache"]["misses"] = misses;
+		stats["record_cache"]["hit_rate"] = hits + misses ? double(hits) / (hits + misses) : 0.0;
+		stats["record_cache"]["entries"] = cache.size();
+
+		hits = rosters.hits();
+		misses = rosters.misses();
+		stats["roster_cache"]["hits"] = hits;
+		stats["roster_cache"]["misses"] = misses;
+		stats["roster_cache"]["hit_rate"] = hits + misses ? double(hits) / (hits + misses) : 0.0;
+		stats["roster_cache"]["courses"] = rosters.size();
+		return crow::response(stats);
+	});
+
+	/*
+	 Prometheus 格式的运行指标：各路由的请求耗时、读写线程里执行SQL的耗时、写线程提交耗时（见 metrics.h），
+	 以及读写队列长度、各个io_service上的连接数和缓存命中次数。
+	 指标里没有学生信息，不检查管理员cookie，方便 Prometheus 直接抓取，不要把这个端口暴露到内网以外。
+	*/
+	ROUTE("/metrics").methods("GET"_method)([&app, &metrics, &writer, &readers, &cache, &rosters, &scores](const crow::request&) {
+		string out;
+		metrics.write(out);
+
+		write_metric_header(out, "ims_db_queue_length", "gauge", "Jobs waiting for a reader or the writer thread.");
+		write_metric(out, "ims_db_queue_length", "pool=\"read\"", static_cast<uint64_t>(readers.queue_length()));
+		write_metric(out, "ims_db_queue_length", "pool=\"write\"", static_cast<uint64_t>(writer.queue_length()));
+
+		// Crow 按这个数把新连接分给最空闲的io_service，其中包括一个正在等待accept的socket
+		vector<unsigned int> lengths = app.task_queue_lengths();
+		uint64_t connections = 0;
+		write_metric_header(out, "ims_io_service_connections", "gauge", "Connections assigned to each Crow io_service, including the socket waiting in accept.");
+		for(size_t i = 0; i < lengths.size(); i++) {
+			write_metric(out, "ims_io_service_connections", "service=\"" + to_string(i) + "\"", static_cast<uint64_t>(lengths[i]));
+			connections += lengths[i];
+		}
+		write_metric_header(out, "ims_open_connections", "gauge", "Open client connections.");
+		write_metric(out, "ims_open_connections", "", connections ? connections - 1 : 0);
+
+		// 命中率用 rate(hits) / (rate(hits) + rate(misses)) 算
+		write_metric_header(out, "ims_cache_hits_total", "counter", "Cache lookups answered from memory.");
+		write_metric(out, "ims_cache_hits_total", "cache=\"records\"", cache.hits());
+		write_metric(out, "ims_cache_hits_total", "cache=\"rosters\"", rosters.hits());
+		write_metric(out, "ims_cache_hits_total", "cache=\"score_columns\"", scores.hits());
+		write_metric_header(out, "ims_cache_misses_total", "counter", "Cache lookups that had to read the database.");
+		write_metric(out, "ims_cache_misses_total", "cache=\"records\"", cache.misses());
+		write_metric(out, "ims_cache_misses_total", "cache=\"rosters\"", rosters.misses());
+		write_metric(out, "ims_cache_misses_total", "cache=\"score_columns\"", scores.misses());
+		write_metric_header(out, "ims_cache_entries", "gauge", "Entries held in each cache.");
+		write_metric(out, "ims_cache_entries", "cache=\"records\"", static_cast<uint64_t>(cache.size()));
+		write_metric(out, "ims_cache_entries", "cache=\"rosters\"", static_cast<uint64_t>(rosters.size()));
+
+		crow::response res(200, out);
+		res.add_header("Content-Type", "text/plain; version=0.0.4");
+		return res;
+	});
+}
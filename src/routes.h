@@ -0,0 +1,47 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#pragma once
+
+#include "crow.h"
+#include "latency.h"
+
+class BatchProgress;
+class DbBackup;
+class DbExecutor;
+class DbWriter;
+class ExportDirectory;
+class Metrics;
+class RecordCache;
+class RosterCache;
+class ScoreColumns;
+class SqlProfiler;
+
+// 服务器用的Crow应用，LatencyRecorder 记录每个请求的耗时
+using ServerApp = crow::App<LatencyRecorder>;
+
+// 路由处理函数要用到的共享对象，由 main() 创建（性能测试里对着临时数据库另外创建一套）
+struct Services {
+	DbWriter& writer;
+	DbExecutor& readers;
+	RecordCache& cache;
+	RosterCache& rosters;
+	ScoreColumns& scores;
+	BatchProgress& batches;
+	ExportDirectory& exports;
+	DbBackup& backup;
+	Metrics& metrics;
+	SqlProfiler& profiler;
+};
+
+/*
+ 注册所有的HTTP接口。服务器和 bench/handler_bench 共用，
+ 性能测试不开端口，直接用 app.handle_full 把构造好的 crow::request 交给这些handler。
+ services 里的对象要比 app 活得久。
+ 同时把请求耗时和读写线程里的SQL耗时接到 services.metrics 上（见 /metrics），读写连接挂上 services.profiler。
+*/
+void register_routes(ServerApp& app, Services& services);
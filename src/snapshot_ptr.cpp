@@ -0,0 +1,108 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#include "snapshot_ptr.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+namespace hazard {
+
+namespace {
+
+// 同时读快照的线程数上限：Crow工作线程、读线程池、写线程再加上后台线程，远远用不完
+const size_t kMaxSlots = 1024;
+
+struct alignas(64) Slot {
+	atomic<bool> used{false};
+	atomic<const void*> ptr{nullptr};
+};
+
+struct Retired {
+	const void* p;
+	void (*deleter)(const void*);
+};
+
+struct Domain {
+	array<Slot, kMaxSlots> slots;
+	// 分出去过的槽数，回收时只需要看前面这些
+	atomic<size_t> high_water{0};
+
+	mutex retire_mtx;
+	vector<Retired> retired;
+};
+
+// 函数里的 static，其他文件的全局对象在构造、析构时用到也没有初始化顺序的问题；进程退出时不释放
+Domain& domain() {
+	static Domain* d = new Domain;
+	return *d;
+}
+
+Slot& acquire_slot() {
+	Domain& d = domain();
+	for (size_t i = 0; i < kMaxSlots; i++) {
+		bool expected = false;
+		if (!d.slots[i].used.load(memory_order_relaxed) && d.slots[i].used.compare_exchange_strong(expected, true, memory_order_acq_rel)) {
+			size_t high = d.high_water.load(memory_order_relaxed);
+			while (high < i + 1 && !d.high_water.compare_exchange_weak(high, i + 1, memory_order_seq_cst)) {
+			}
+			return d.slots[i];
+		}
+	}
+	cerr << "hazard: more than " << kMaxSlots << " threads reading snapshots" << endl;
+	abort();
+}
+
+struct LocalSlot {
+	Slot& slot = acquire_slot();
+	~LocalSlot() {
+		slot.ptr.store(nullptr, memory_order_release);
+		slot.used.store(false, memory_order_release);
+	}
+};
+
+} // namespace
+
+atomic<const void*>& local_slot() {
+	thread_local LocalSlot local;
+	return local.slot.ptr;
+}
+
+void retire(const void* p, void (*deleter)(const void*)) {
+	Domain& d = domain();
+	vector<Retired> to_free;
+	{
+		lock_guard<mutex> lock(d.retire_mtx);
+		d.retired.push_back({p, deleter});
+
+		// 新发布的指针已经换上去了（seq_cst），这之后读到的槽如果没有指向旧对象，那个读者也不可能再拿到它
+		vector<const void*> in_use;
+		size_t high = d.high_water.load(memory_order_seq_cst);
+		for (size_t i = 0; i < high; i++)
+			if (const void* q = d.slots[i].ptr.load(memory_order_seq_cst))
+				in_use.push_back(q);
+		sort(in_use.begin(), in_use.end());
+
+		auto keep = partition(d.retired.begin(), d.retired.end(), [&in_use](const Retired& r) {
+			return binary_search(in_use.begin(), in_use.end(), r.p);
+		});
+		to_free.assign(keep, d.retired.end());
+		d.retired.erase(keep, d.retired.end());
+	}
+
+	// 释放一个分片的map可能要一些时间，不占着锁
+	for (const Retired& r : to_free)
+		r.deleter(r.p);
+}
+
+} // namespace hazard
@@ -0,0 +1,78 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+namespace hazard {
+
+// 当前线程的 hazard 槽：读者把正在用的对象地址写在这里，回收时跳过这些地址。
+// 每个线程第一次读时分到一个槽，线程退出时归还
+std::atomic<const void*>& local_slot();
+
+// 对象已经不再发布，等到没有任何线程的槽指向它时用 deleter 释放（可能就在这次调用里）
+void retire(const void* p, void (*deleter)(const void*));
+
+} // namespace hazard
+
+/*
+ 发布不可修改对象的指针，读的时候不加任何锁。
+ libstdc++ 的 std::atomic_load / std::atomic_store(shared_ptr*) 内部用的是全局的一组自旋锁，
+ 所有读者都要抢同一批锁，这里改用裸指针加 hazard pointer：
+	读：把当前指针写进自己线程的槽，再读一遍确认没有被替换，然后直接使用，用完清空槽。
+	    只有原子读写，没有锁也没有引用计数。
+	写：原子地换成新对象，旧对象交给 hazard::retire，没有读者在用时才释放。
+ 写者之间需要调用方自己互斥（比如分片的 write_mtx）。
+
+ 每个线程只有一个槽，所以 read() 的回调里不能再 read 别的 SnapshotPtr。
+*/
+template <typename T>
+class SnapshotPtr {
+public:
+	explicit SnapshotPtr(std::unique_ptr<const T> initial = std::make_unique<const T>()) : ptr_(initial.release()) {}
+	// 析构时不能再有读者
+	~SnapshotPtr() { delete ptr_.load(std::memory_order_relaxed); }
+
+	SnapshotPtr(const SnapshotPtr&) = delete;
+	SnapshotPtr& operator=(const SnapshotPtr&) = delete;
+
+	// 在 f 里使用当前发布的对象，返回 f 的结果。f 返回之后对象可能就被释放了，不要把引用带出来
+	template <typename F>
+	decltype(auto) read(F&& f) const {
+		Guard guard(hazard::local_slot());
+		const T* p = ptr_.load(std::memory_order_acquire);
+		while (true) {
+			guard.slot.store(p, std::memory_order_seq_cst);
+			// 写进槽之后指针没变，说明写者在替换之前一定能看到这个槽，对象不会被释放
+			const T* current = ptr_.load(std::memory_order_seq_cst);
+			if (current == p)
+				break;
+			p = current;
+		}
+		return f(*p);
+	}
+
+	// 只有写者（持有调用方的写锁时）可以用，返回值在下一次 store 之前有效
+	const T& current() const { return *ptr_.load(std::memory_order_relaxed); }
+
+	void store(std::unique_ptr<const T> next) {
+		const T* old = ptr_.exchange(next.release(), std::memory_order_seq_cst);
+		hazard::retire(old, [](const void* p) { delete static_cast<const T*>(p); });
+	}
+
+private:
+	struct Guard {
+		explicit Guard(std::atomic<const void*>& s) : slot(s) {}
+		~Guard() { slot.store(nullptr, std::memory_order_release); }
+		std::atomic<const void*>& slot;
+	};
+
+	std::atomic<const T*> ptr_;
+};
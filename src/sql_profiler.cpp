@@ -0,0 +1,283 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#include "sql_profiler.h"
+#include "crow.h"
+
+#include <algorithm>
+#include <cctype>
+
+using namespace std;
+
+namespace {
+
+// 每个连接最多统计这么多条不同的SQL，按规定SQL都是固定文本，超过说明有人把数据拼进了SQL
+const size_t kMaxEntries = 1000;
+
+bool is_identifier_char(char c) {
+	return isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$';
+}
+
+} // namespace
+
+string normalize_sql(string_view sql) {
+	string out;
+	out.reserve(sql.size());
+	bool space = false;
+	for (size_t i = 0; i < sql.size(); i++) {
+		char c = sql[i];
+		if (isspace(static_cast<unsigned char>(c))) {
+			space = !out.empty();
+			continue;
+		}
+		if (space) {
+			out += ' ';
+			space = false;
+		}
+
+		if (c == '\'') {
+			// 字符串字面量，'' 是转义的单引号，i 停在结尾的引号上
+			for (i++; i < sql.size(); i++) {
+				if (sql[i] != '\'')
+					continue;
+				if (i + 1 < sql.size() && sql[i + 1] == '\'')
+					i++;
+				else
+					break;
+			}
+			out += '?';
+		} else if (isdigit(static_cast<unsigned char>(c)) && (out.empty() || !is_identifier_char(out.back()))) {
+			while (i + 1 < sql.size() && (isalnum(static_cast<unsigned char>(sql[i + 1])) || sql[i + 1] == '.'))
+				i++;
+			out += '?';
+		} else {
+			out += c;
+		}
+	}
+	return out;
+}
+
+SqlProfiler::SqlProfiler(string db_path, chrono::milliseconds slow_threshold)
+	: db_path_(move(db_path)), slow_ns_(chrono::nanoseconds(slow_threshold).count()) {
+	// 先打开连接，打不开时直接抛出去，还没有线程在运行
+	auto conn = make_shared<Connection>(db_path_);
+	thread_ = thread([this, conn] {
+		run(*conn);
+	});
+}
+
+SqlProfiler::~SqlProfiler() {
+	{
+		lock_guard<mutex> lock(mtx_);
+		stopping_ = true;
+	}
+	cv_.notify_one();
+	thread_.join();
+}
+
+void SqlProfiler::attach(Connection& conn) {
+	auto tracer = make_unique<Tracer>();
+	tracer->profiler = this;
+	sqlite3_trace_v2(conn.get(), SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE, &SqlProfiler::on_trace, tracer.get());
+
+	lock_guard<mutex> lock(tracers_mtx_);
+	tracers_.push_back(move(tracer));
+}
+
+void SqlProfiler::set_slow_threshold(chrono::milliseconds threshold) {
+	slow_ns_.store(chrono::nanoseconds(threshold).count(), memory_order_relaxed);
+}
+
+chrono::milliseconds SqlProfiler::slow_threshold() const {
+	return chrono::duration_cast<chrono::milliseconds>(chrono::nanoseconds(slow_ns_.load(memory_order_relaxed)));
+}
+
+int SqlProfiler::on_trace(unsigned type, void* ctx, void* p, void* x) {
+	Tracer& tracer = *static_cast<Tracer*>(ctx);
+	auto* stmt = static_cast<sqlite3_stmt*>(p);
+
+	// running 只有正在用这个连接的线程访问，不用加锁
+	if (type == SQLITE_TRACE_STMT) {
+		// 触发器里的语句也会触发一次，文本是 "-- TRIGGER 名字"，耗时算在外面的语句里
+		const char* text = static_cast<const char*>(x);
+		if (text && text[0] == '-' && text[1] == '-')
+			return 0;
+		auto now = chrono::steady_clock::now();
+		for (auto& entry : tracer.running)
+			if (entry.first == stmt) {
+				entry.second = now;
+				return 0;
+			}
+		tracer.running.emplace_back(stmt, now);
+		return 0;
+	}
+
+	if (type == SQLITE_TRACE_PROFILE) {
+		uint64_t ns = static_cast<uint64_t>(*static_cast<sqlite3_int64*>(x));
+		for (size_t i = 0; i < tracer.running.size(); i++)
+			if (tracer.running[i].first == stmt) {
+				ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - tracer.running[i].second).count();
+				tracer.running.erase(tracer.running.begin() + i);
+				break;
+			}
+		tracer.profiler->on_statement_end(tracer, stmt, ns);
+	}
+	return 0;
+}
+
+void SqlProfiler::on_statement_end(Tracer& tracer, sqlite3_stmt* stmt, uint64_t ns) {
+	const char* sql = sqlite3_sql(stmt);
+	if (!sql)
+		return;
+
+	// 取出这次执行的步数并清零
+	uint64_t full_scan_steps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+	uint64_t vm_steps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 1);
+
+	{
+		lock_guard<mutex> lock(tracer.mtx);
+		auto it = tracer.entries.find(string_view(sql));
+		if (it == tracer.entries.end()) {
+			if (tracer.entries.size() >= kMaxEntries)
+				return;
+			auto entry = make_unique<Entry>();
+			entry->sql = sql;
+			string_view key = entry->sql;
+			it = tracer.entries.emplace(key, move(entry)).first;
+		}
+		Entry& entry = *it->second;
+		entry.count++;
+		entry.total_ns += ns;
+		entry.max_ns = max(entry.max_ns, ns);
+		entry.full_scan_steps += full_scan_steps;
+		entry.vm_steps += vm_steps;
+	}
+
+	int64_t slow_ns = slow_ns_.load(memory_order_relaxed);
+	if (slow_ns <= 0 || ns < static_cast<uint64_t>(slow_ns))
+		return;
+
+	slow_count_.fetch_add(1, memory_order_relaxed);
+	{
+		lock_guard<mutex> lock(mtx_);
+		// 后台线程跟不上时丢掉，不能让读写线程等日志
+		if (queue_.size() >= kMaxQueue)
+			return;
+		queue_.push_back({sql, ns});
+	}
+	cv_.notify_one();
+}
+
+void SqlProfiler::run(Connection& conn) {
+	while (true) {
+		SlowQuery query;
+		{
+			unique_lock<mutex> lock(mtx_);
+			cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+			if (stopping_)
+				return;
+
+			query = move(queue_.front());
+			queue_.pop_front();
+		}
+
+		string normalized = normalize_sql(query.sql);
+		string plan = explain(conn, query.sql);
+		CROW_LOG_WARNING << "Slow SQL (" << query.ns / 1e6 << " ms): " << normalized << (plan.empty() ? "" : "\n") << plan;
+
+		lock_guard<mutex> lock(plans_mtx_);
+		plans_[normalized] = move(plan);
+	}
+}
+
+string SqlProfiler::explain(Connection& conn, const string& sql) {
+	// 不放进连接的语句缓存，慢查询的SQL不一定是固定的那几条
+	string eqp = "EXPLAIN QUERY PLAN " + sql;
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(conn.get(), eqp.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+		sqlite3_finalize(stmt);
+		return string("(EXPLAIN QUERY PLAN failed: ") + sqlite3_errmsg(conn.get()) + ")";
+	}
+
+	// 每行是 id、parent、notused、detail，按 parent 缩进成一棵树
+	string plan;
+	vector<pair<int, int>> depths;
+	while (sqlite3_step(stmt) == SQLITE_ROW) {
+		int id = sqlite3_column_int(stmt, 0);
+		int parent = sqlite3_column_int(stmt, 1);
+		int depth = 0;
+		for (const auto& d : depths)
+			if (d.first == parent)
+				depth = d.second + 1;
+		depths.emplace_back(id, depth);
+
+		if (!plan.empty())
+			plan += '\n';
+		plan.append(depth * 2, ' ');
+		plan += reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+	}
+	sqlite3_finalize(stmt);
+	return plan;
+}
+
+vector<SqlStatementStats> SqlProfiler::top(size_t limit, Order order) {
+	unordered_map<string, SqlStatementStats> merged;
+	{
+		lock_guard<mutex> tracers_lock(tracers_mtx_);
+		for (const auto& tracer : tracers_) {
+			lock_guard<mutex> lock(tracer->mtx);
+			for (const auto& item : tracer->entries) {
+				const Entry& entry = *item.second;
+				string normalized = normalize_sql(entry.sql);
+				SqlStatementStats& stats = merged[normalized];
+				stats.count += entry.count;
+				stats.total_ns += entry.total_ns;
+				stats.max_ns = max(stats.max_ns, entry.max_ns);
+				stats.full_scan_steps += entry.full_scan_steps;
+				stats.vm_steps += entry.vm_steps;
+			}
+		}
+	}
+
+	vector<SqlStatementStats> result;
+	result.reserve(merged.size());
+	{
+		lock_guard<mutex> lock(plans_mtx_);
+		for (auto& item : merged) {
+			item.second.sql = item.first;
+			auto plan = plans_.find(item.first);
+			if (plan != plans_.end())
+				item.second.plan = plan->second;
+			result.push_back(move(item.second));
+		}
+	}
+
+	auto key = [order](const SqlStatementStats& s) {
+		return order == Order::Max ? s.max_ns : order == Order::Count ? s.count : s.total_ns;
+	};
+	sort(result.begin(), result.end(), [&key](const SqlStatementStats& a, const SqlStatementStats& b) {
+		return key(a) != key(b) ? key(a) > key(b) : a.sql < b.sql;
+	});
+	if (result.size() > limit)
+		result.resize(limit);
+	return result;
+}
+
+void SqlProfiler::reset() {
+	{
+		lock_guard<mutex> tracers_lock(tracers_mtx_);
+		for (const auto& tracer : tracers_) {
+			lock_guard<mutex> lock(tracer->mtx);
+			tracer->entries.clear();
+		}
+	}
+	{
+		lock_guard<mutex> lock(plans_mtx_);
+		plans_.clear();
+	}
+	slow_count_.store(0, memory_order_relaxed);
+}
@@ -0,0 +1,121 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+#pragma once
+
+#include "connection.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// /admin/sql_profile 报告里的一条SQL（相同的SQL去掉多余空白和字面量后合并）
+struct SqlStatementStats {
+	std::string sql;
+	std::uint64_t count = 0;
+	std::uint64_t total_ns = 0;
+	std::uint64_t max_ns = 0;
+	// 全表扫描和虚拟机执行的步数，全表扫描步数很大一般说明缺索引
+	std::uint64_t full_scan_steps = 0;
+	std::uint64_t vm_steps = 0;
+	// 最近一次超过慢查询阈值时的 EXPLAIN QUERY PLAN，一直没超过时为空
+	std::string plan;
+};
+
+/*
+ SQL性能分析：用 sqlite3_trace_v2 挂在读写线程的每个连接上，统计每条SQL的执行次数、总耗时、最长耗时。
+ /get_course、/login 变慢时可以看出是哪条语句慢、有没有全表扫描。
+
+ SQLite在 SQLITE_TRACE_PROFILE 里给的耗时来自VFS的时钟，unix下只精确到毫秒，大部分语句都是0，
+ 所以同时注册 SQLITE_TRACE_STMT，在语句开始时自己记下 steady_clock，语句结束时算耗时。
+
+ 统计按连接分开存（一个连接同一时刻只有一个线程在用，锁基本没有争用），生成报告时再合并。
+ 超过阈值的语句放进队列，由后台线程在自己的连接上跑 EXPLAIN QUERY PLAN 后写日志，
+ 不在读写线程里多查一次。日志里是带 ? 的SQL，不含绑定的参数（可能有学生的个人信息）。
+*/
+class SqlProfiler {
+public:
+	SqlProfiler(std::string db_path, std::chrono::milliseconds slow_threshold);
+	// 停止后台线程，丢弃还没记录的慢查询。挂上的连接要先关闭
+	~SqlProfiler();
+
+	SqlProfiler(const SqlProfiler&) = delete;
+	SqlProfiler& operator=(const SqlProfiler&) = delete;
+
+	// 开始统计这个连接上的语句，要在连接开始使用之前调用；profiler 要比连接活得久
+	void attach(Connection& conn);
+
+	void set_slow_threshold(std::chrono::milliseconds threshold);
+	std::chrono::milliseconds slow_threshold() const;
+
+	// 按 total_ns（或 max_ns、count）从大到小取前 limit 条
+	enum class Order { Total, Max, Count };
+	std::vector<SqlStatementStats> top(std::size_t limit, Order order);
+	std::uint64_t slow_count() const { return slow_count_.load(std::memory_order_relaxed); }
+	void reset();
+
+private:
+	// 一个连接的统计，键是 sqlite3_sql() 的原文，指向 Entry 里保存的字符串
+	struct Entry {
+		std::string sql;
+		std::uint64_t count = 0;
+		std::uint64_t total_ns = 0;
+		std::uint64_t max_ns = 0;
+		std::uint64_t full_scan_steps = 0;
+		std::uint64_t vm_steps = 0;
+	};
+
+	struct Tracer {
+		SqlProfiler* profiler;
+		std::mutex mtx;
+		std::unordered_map<std::string_view, std::unique_ptr<Entry>> entries;
+		// 正在执行的语句和开始时间，同一连接上可能同时有几条语句没执行完
+		std::vector<std::pair<sqlite3_stmt*, std::chrono::steady_clock::time_point>> running;
+	};
+
+	struct SlowQuery {
+		std::string sql;
+		std::uint64_t ns;
+	};
+
+	static int on_trace(unsigned type, void* ctx, void* p, void* x);
+	void on_statement_end(Tracer& tracer, sqlite3_stmt* stmt, std::uint64_t ns);
+	void run(Connection& conn);
+	std::string explain(Connection& conn, const std::string& sql);
+
+	std::string db_path_;
+	std::atomic<std::int64_t> slow_ns_;
+	std::atomic<std::uint64_t> slow_count_{0};
+
+	std::mutex tracers_mtx_;
+	std::vector<std::unique_ptr<Tracer>> tracers_;
+
+	// 慢查询的执行计划，键是规范化后的SQL
+	std::mutex plans_mtx_;
+	std::unordered_map<std::string, std::string> plans_;
+
+	static constexpr std::size_t kMaxQueue = 100;
+	std::deque<SlowQuery> queue_;
+	std::mutex mtx_;
+	std::condition_variable cv_;
+	bool stopping_ = false;
+	std::thread thread_;
+};
+
+// 把SQL里连续的空白合并成一个空格，数字和字符串字面量换成 ?，用来合并只差参数的语句
+std::string normalize_sql(std::string_view sql);
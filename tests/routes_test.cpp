@@ -0,0 +1,385 @@
+/*
+ * Project Name: Information Management System
+ * Author: ReinerBrown
+ * Copyright (c) 2024 ReinerBrown
+ * License: MIT License
+ */
+
+// 接口的回归测试：和 bench/handler_bench 一样不开端口，对着临时数据库建好写线程、读线程池和缓存，
+// 构造 crow::request 交给 app.handle_full，检查状态码、响应和数据库里的结果。
+// 有失败时返回1，ctest 据此判断。
+
+#include "backup.h"
+#include "batch_progress.h"
+#include "bench_common.h"
+#include "connection.h"
+#include "course_stats.h"
+#include "csv_import.h"
+#include "db_executor.h"
+#include "db_writer.h"
+#include "export.h"
+#include "metrics.h"
+#include "migrations.h"
+#include "record_cache.h"
+#include "roster_cache.h"
+#include "routes.h"
+#include "sql_profiler.h"
+
+#include <nlohmann/json.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+using namespace std;
+
+namespace {
+
+using IoService = remove_pointer_t<decltype(crow::request::io_service)>;
+
+const string kDbPath = "routes_test.db";
+
+int failures = 0;
+
+void check(bool ok, const string& what) {
+	if (!ok) {
+		cerr << "FAILED: " << what << endl;
+		failures++;
+	}
+}
+
+// io 要比读写线程活得久：线程 post 完响应之后还会访问它
+class Driver {
+public:
+	Driver(ServerApp& app, IoService& io) : app_(app), io_(io), work_(io_) {}
+
+	crow::response post(const string& url, string body) {
+		crow::request req;
+		req.method = crow::HTTPMethod::Post;
+		req.url = url;
+		req.raw_url = url;
+		req.body = move(body);
+		req.headers.emplace("Cookie", "session_id=admin, session_type=admin");
+		req.io_service = &io_;
+
+		crow::response res;
+		app_.handle_full(req, res);
+		while (!res.is_completed())
+			io_.run_one();
+		return res;
+	}
+
+private:
+	ServerApp& app_;
+	IoService& io_;
+	IoService::work work_;
+};
+
+// 直接查数据库里的一个整数，查不到返回 -100
+int query_int(Connection& conn, const string& sql) {
+	auto stmt = conn.prepare(sql);
+	if (!stmt || sqlite3_step(stmt) != SQLITE_ROW)
+		return -100;
+	return sqlite3_column_int(stmt, 0);
+}
+
+int query_int(const string& sql) {
+	Connection conn(kDbPath);
+	return query_int(conn, sql);
+}
+
+// 查一个字符串，查不到或为NULL时返回 "<none>"
+string query_text(Connection& conn, const string& sql) {
+	auto stmt = conn.prepare(sql);
+	if (!stmt || sqlite3_step(stmt) != SQLITE_ROW || !sqlite3_column_text(stmt, 0))
+		return "<none>";
+	return reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+}
+
+nlohmann::json parse(const crow::response& res) {
+	return nlohmann::json::parse(res.body, nullptr, false);
+}
+
+// 缺少 stu_id / new_score 的行要作为 invalid row 拒绝整批，不能访问不存在的key
+void test_insert_score_missing_fields(Driver& driver) {
+	auto res = driver.post("/insert_score", R"([{"option":"score1","new_score":90}])");
+	auto report = parse(res);
+	check(res.code == 400, "insert_score without stu_id returns 400");
+	check(report.is_object() && report.value("committed", true) == false, "insert_score without stu_id is not committed");
+	check(report.is_object() && report["results"].size() == 1 && report["results"][0]["stu_id"].is_null()
+		&& report["results"][0]["result"] == "invalid row", "insert_score without stu_id reports an invalid row");
+
+	res = driver.post("/insert_score", R"([{"stu_id":1,"option":"score1","new_score":90},{"stu_id":2,"option":"score1"}])");
+	report = parse(res);
+	check(res.code == 400, "insert_score without new_score returns 400");
+	check(report.is_object() && report["results"].size() == 2 && report["results"][1]["result"] == "invalid row",
+		"insert_score without new_score reports an invalid row");
+	check(query_int("SELECT score FROM enrollments WHERE student_id = 1 AND course_id = 'C1';") == -1,
+		"a rejected insert_score batch is rolled back");
+
+	res = driver.post("/insert_score", R"([{"stu_id":1,"option":"score1","new_score":90}])");
+	check(res.code == 200, "valid insert_score returns 200");
+	check(query_int("SELECT score FROM enrollments WHERE student_id = 1 AND course_id = 'C1';") == 90,
+		"valid insert_score updates the score");
+}
+
+// course_id 给了但不是字符串时是 invalid row，不能因为 type_error 让整批变成500
+void test_insert_score_course_id_type(Driver& driver) {
+	auto res = driver.post("/insert_score", R"([{"stu_id":2,"course_id":101,"option":"score1","new_score":80}])");
+	auto report = parse(res);
+	check(res.code == 400, "insert_score with a numeric course_id returns 400");
+	check(report.is_object() && report["results"].size() == 1 && report["results"][0]["result"] == "invalid row",
+		"insert_score with a numeric course_id reports an invalid row");
+
+	res = driver.post("/insert_score", R"([{"stu_id":2,"course_id":null,"new_score":80}])");
+	report = parse(res);
+	check(res.code == 400 && report.is_object() && report["results"][0]["result"] == "invalid row",
+		"insert_score with a null course_id reports an invalid row");
+
+	res = driver.post("/insert_score", R"([{"stu_id":2,"course_id":"C3","new_score":80}])");
+	check(res.code == 200, "insert_score with a course_id string returns 200");
+	check(query_int("SELECT score FROM enrollments WHERE student_id = 2 AND course_id = 'C3';") == 80,
+		"insert_score with a course_id string updates that course");
+}
+
+// 直接执行一条SQL，用来准备数据
+void exec(const string& sql) {
+	Connection conn(kDbPath);
+	bench::exec_or_die(conn.get(), sql);
+}
+
+// 申请指向的选课或学生已经不存在时，审核不能报成功，申请也不能被删掉
+void test_approve_missing_target(Driver& driver) {
+	exec("INSERT INTO requests_teacher (req_id, stu_id, option, new_score, course_id) VALUES ('t-dropped', 3, 'score1', 75, 'C9');");
+	auto res = driver.post("/unsolvereq", R"({"req_status":"确认","req_id":"t-dropped","req_type":"teacher"})");
+	check(res.code == 400, "approving a score change for a course the student is not in returns 400");
+	check(query_int("SELECT count(*) FROM requests_teacher WHERE req_id = 't-dropped';") == 1,
+		"a failed score change approval keeps the request");
+
+	exec("INSERT INTO requests_student (req_id, id, name, gender, phone_number, wish) VALUES ('s-gone', 999, 'x', 1, '1', '保外');");
+	res = driver.post("/unsolvereq", R"({"req_status":"确认","req_id":"s-gone","req_type":"student"})");
+	check(res.code >= 400, "approving an info change for a missing student fails");
+	check(query_int("SELECT count(*) FROM requests_student WHERE req_id = 's-gone';") == 1,
+		"a failed info change approval keeps the request");
+
+	res = driver.post("/admin/requests/batch", R"({"items":[{"req_type":"teacher","req_id":"t-dropped","decision":"approve"}]})");
+	auto report = parse(res);
+	check(report.is_object() && report["results"].size() == 1 && report["results"][0]["result"] == "invalid option",
+		"batch approval of a score change for a course the student is not in reports invalid option");
+	check(query_int("SELECT count(*) FROM requests_teacher WHERE req_id = 't-dropped';") == 1,
+		"a failed batch approval keeps the request");
+}
+
+// 条目里的字段类型不对时只把这一条标成 invalid item，其他条目照常处理
+void test_batch_invalid_field_types(Driver& driver) {
+	exec("INSERT INTO requests_teacher (req_id, stu_id, option, new_score, course_id) VALUES ('t-batch', 4, 'score1', 66, 'C4');");
+	auto res = driver.post("/admin/requests/batch", R"({"items":[
+		{"req_type":1,"req_id":"t-batch","decision":"approve"},
+		{"req_type":"teacher","req_id":"t-batch","decision":true},
+		{"req_type":"teacher","req_id":"t-batch","decision":"approve"}]})");
+	auto report = parse(res);
+	check(res.code == 200, "batch with badly typed items returns 200");
+	check(report.is_object() && report["results"].size() == 3 && report["results"][0]["result"] == "invalid item"
+		&& report["results"][1]["result"] == "invalid item" && report["results"][2]["result"] == "approved",
+		"badly typed batch items are reported as invalid items");
+	check(query_int("SELECT score FROM enrollments WHERE student_id = 4 AND course_id = 'C4';") == 66,
+		"the valid batch item is applied");
+}
+
+// 缓存的名单在录入成绩的响应返回之前就已经是新的
+void test_roster_after_insert_score(Driver& driver) {
+	auto before = driver.post("/get_course", R"({"course_id":"C0"})");
+	check(before.code == 200, "get_course returns 200");
+
+	auto res = driver.post("/insert_score", R"([{"stu_id":5,"course_id":"C0","new_score":55},{"stu_id":10,"course_id":"C0","new_score":56}])");
+	check(res.code == 200, "insert_score into a cached roster returns 200");
+
+	auto after = driver.post("/get_course", R"({"course_id":"C0"})");
+	auto roster = parse(after);
+	int found = 0;
+	if (roster.is_array())
+		for (const auto& row : roster)
+			if ((row["id"] == 5 && row["score"] == 55) || (row["id"] == 10 && row["score"] == 56))
+				found++;
+	check(found == 2, "get_course shows scores patched by insert_score");
+	check(after.get_header_value("ETag") != before.get_header_value("ETag"), "the roster ETag changes after a patch");
+}
+
+// 上传的CSV直接从请求体里读
+void test_import_students(Driver& driver) {
+	auto res = driver.post("/admin/import/students",
+		"id,name,class,password,phone_number,gender,wish\n"
+		"101,\"Zhao, Yi\",7,1234,555,1,保内\n"
+		"102,Qian,7,1234,556,0,保外\n"
+		"bad,row\n");
+	check(res.code == 200, "importing students returns 200");
+	check(query_int("SELECT class FROM students WHERE id = 101 AND name = 'Zhao, Yi';") == 7, "imported student with a quoted name");
+	check(query_int("SELECT count(*) FROM students WHERE id IN (101, 102);") == 2, "both valid student rows are imported");
+
+	res = driver.post("/admin/import/students", "id,name\n1,x\n");
+	check(res.code == 400, "importing with a wrong header returns 400");
+}
+
+string read_file(const string& path) {
+	ifstream file(path, ios::binary);
+	return string(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+// 导出的列和顺序来自 StudentExportRow / GradeRow，CSV里带逗号的姓名要加引号
+void test_write_export() {
+	Connection conn(kDbPath);
+	ExportFilter filter;
+	filter.class_no = 7;
+	const string path = "routes_test_exports/students.csv";
+	size_t rows = write_export(conn, ExportKind::Students, ExportFormat::Csv, filter, path);
+	// 测试数据里的学生7也在7班
+	string csv = read_file(path);
+	const string header = "\xEF\xBB\xBF" "id,name,class,phone_number,gender,wish\n";
+	const string imported = "101,\"Zhao, Yi\",7,555,1,保内\n102,Qian,7,556,0,保外\n";
+	check(rows == 3, "exporting class 7 writes every student in it");
+	check(csv.compare(0, header.size(), header) == 0 && csv.size() >= imported.size()
+		&& csv.compare(csv.size() - imported.size(), imported.size(), imported) == 0, "students CSV export matches");
+
+	filter = {};
+	filter.course_id = "C3";
+	const string ndjson = "routes_test_exports/enrollments.ndjson";
+	rows = write_export(conn, ExportKind::Enrollments, ExportFormat::Ndjson, filter, ndjson);
+	string lines = read_file(ndjson);
+	auto first = nlohmann::json::parse(lines.substr(0, lines.find('\n')), nullptr, false);
+	check(rows == 4, "exporting course C3 writes its four enrollments");
+	check(first.is_object() && first.size() == 5 && first["student_id"] == 2 && first["course_id"] == "C3"
+		&& first["score"] == 80 && first.contains("name") && first["class"].is_number(), "enrollments NDJSON export matches");
+}
+
+// 读一段内存里的CSV，返回第一行
+vector<string> first_record(string_view csv) {
+	MemoryStreamBuf buf(csv);
+	istream in(&buf);
+	CsvReader reader(in);
+	vector<string> fields;
+	reader.next(fields);
+	return fields;
+}
+
+// 只有 EF BB BF 才是BOM，其他 0xEF 开头的字符（U+Fxxx）要原样保留
+void test_csv_bom() {
+	check(first_record("\xEF\xBB\xBFid,name\n1,x\n") == vector<string>{"id", "name"}, "a UTF-8 BOM is skipped");
+	check(first_record("\xEF\xBC\x81id,name\n") == vector<string>{"\xEF\xBC\x81id", "name"},
+		"a leading U+FF01 is kept");
+	check(first_record("\xEF\xBB,x\n") == vector<string>{"\xEF\xBB", "x"}, "a truncated BOM is kept");
+	check(first_record("\xEF") == vector<string>{"\xEF"}, "a lone 0xEF is kept");
+}
+
+void remove_db(const string& path) {
+	remove(path.c_str());
+	remove((path + "-wal").c_str());
+	remove((path + "-shm").c_str());
+}
+
+/*
+ 旧结构的数据库升级到最新版本：
+	版本2按 id/req_id 去重（保留最后一条）、丢掉没有id的行，
+	版本3把 course1/course2 拆到 enrollments，按 option 补上申请的 course_id。
+ 再运行一次不应该有任何修改。
+*/
+void test_legacy_upgrade() {
+	const string path = "routes_test_legacy.db";
+	// 学生 1..4，学生i选了 C(i%3) 和 C((i+1)%3)
+	bench::create_legacy_db(path, 4, 3);
+	{
+		Connection conn(path);
+		bench::exec_or_die(conn.get(), R"(
+			INSERT INTO students VALUES (2, 'student2 again', 5, 1, 'C1', 'C2', 88, -1, '2', 0, '保外', 0, 1);
+			INSERT INTO students VALUES (NULL, 'no id', 5, 1, 'C0', 'C1', 70, 70, '0', 0, '保内', 1, 1);
+			INSERT INTO requests_teacher VALUES ('t-score2', 4, 'score2', 91);
+			INSERT INTO requests_teacher VALUES ('t-score1', 1, 'score1', 92);
+			INSERT INTO requests_teacher VALUES ('t-score1', 1, 'score1', 93);
+			INSERT INTO requests_teacher VALUES ('t-unknown', 99, 'score1', 94);
+		)");
+	}
+
+	Connection conn(path);
+	run_migrations(conn);
+	check(schema_version(conn) == latest_schema_version(), "legacy database is upgraded to the latest version");
+	check(query_int(conn, "SELECT count(*) FROM students;") == 4, "students with a duplicate or missing id are dropped");
+	check(query_text(conn, "SELECT name FROM students WHERE id = 2;") == "student2 again", "the last duplicate student row is kept");
+
+	check(query_int(conn, "SELECT count(*) FROM enrollments;") == 8, "every student keeps two enrollments");
+	check(query_int(conn, "SELECT score FROM enrollments WHERE student_id = 2 AND course_id = 'C1';") == 88
+		&& query_int(conn, "SELECT able_to_revise FROM enrollments WHERE student_id = 2 AND course_id = 'C1';") == 0
+		&& query_int(conn, "SELECT score FROM enrollments WHERE student_id = 2 AND course_id = 'C2';") == -1,
+		"enrollments come from course1/score1 and course2/score2");
+	check(query_int(conn, "SELECT count(*) FROM enrollments WHERE student_id = 3 AND course_id IN ('C0', 'C1');") == 2,
+		"enrollments of an untouched student");
+	check(query_int(conn, "SELECT enrolled FROM course_aggregates WHERE course_id = 'C1';") == 4,
+		"course aggregates are built from the migrated enrollments");
+
+	check(query_int(conn, "SELECT count(*) FROM requests_teacher;") == 3, "duplicate req_id rows are dropped");
+	check(query_text(conn, "SELECT course_id FROM requests_teacher WHERE req_id = 't-score2';") == "C2",
+		"a score2 request is backfilled with the student's second course");
+	check(query_text(conn, "SELECT course_id FROM requests_teacher WHERE req_id = 't-score1';") == "C1"
+		&& query_int(conn, "SELECT new_score FROM requests_teacher WHERE req_id = 't-score1';") == 93,
+		"a score1 request is backfilled with the first course and the last duplicate is kept");
+	check(query_text(conn, "SELECT course_id FROM requests_teacher WHERE req_id = 't-unknown';") == "<none>",
+		"a request for a missing student keeps a NULL course_id");
+
+	int changes = sqlite3_total_changes(conn.get());
+	run_migrations(conn);
+	check(sqlite3_total_changes(conn.get()) == changes && schema_version(conn) == latest_schema_version(),
+		"running the migrations again changes nothing");
+
+	remove_db(path);
+}
+
+} // namespace
+
+int main() {
+	test_legacy_upgrade();
+	test_csv_bom();
+
+	// 学生 1..10，学生i选了 C(i%5) 和 C((i+1)%5)，成绩都是-1
+	bench::create_legacy_db(kDbPath, 10, 5);
+	RecordCache cache;
+	{
+		Connection conn(kDbPath);
+		run_migrations(conn);
+		cache.load_all(conn);
+	}
+
+	RosterCache rosters;
+	ScoreColumns scores;
+	BatchProgress batches;
+	{
+		IoService io;
+		Metrics metrics;
+		SqlProfiler profiler(kDbPath, chrono::milliseconds(0));
+		DbWriter writer(kDbPath);
+		DbExecutor readers(kDbPath, 1);
+		ExportDirectory exports("routes_test_exports");
+		DbBackup backup(kDbPath, "routes_test_backups");
+		Services services{writer, readers, cache, rosters, scores, batches, exports, backup, metrics, profiler};
+
+		ServerApp app;
+		register_routes(app, services);
+		app.validate();
+		Driver driver(app, io);
+
+		test_insert_score_missing_fields(driver);
+		test_insert_score_course_id_type(driver);
+		test_approve_missing_target(driver);
+		test_batch_invalid_field_types(driver);
+		test_roster_after_insert_score(driver);
+		test_import_students(driver);
+		test_write_export();
+	}
+
+	remove_db(kDbPath);
+	filesystem::remove_all("routes_test_exports");
+	filesystem::remove_all("routes_test_backups");
+
+	if (failures)
+		cerr << failures << " check(s) failed" << endl;
+	else
+		cout << "all checks passed" << endl;
+	return failures ? 1 : 0;
+}